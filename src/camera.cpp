@@ -43,3 +43,11 @@ CameraIntrinsics makeCameraIntrinsics(size_t width, size_t height)
     intrinsics.height = height;
     return intrinsics;
 }
+
+CameraExtrinsics makeCubeFaceExtrinsics(const Vector4d& position, int face)
+{
+    const auto pi = 3.14159265358979323846;
+    const double yaws[NUM_CUBE_FACES]    = { 0.0, 0.5 * pi, pi, 1.5 * pi, 0.0, 0.0 };
+    const double pitches[NUM_CUBE_FACES] = { 0.0, 0.0, 0.0, 0.0, 0.5 * pi, -0.5 * pi };
+    return CameraExtrinsics{ position(0), position(1), position(2), yaws[face], pitches[face] };
+}
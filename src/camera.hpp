@@ -23,6 +23,11 @@ struct CameraIntrinsics
 
 CameraIntrinsics makeCameraIntrinsics(size_t width, size_t height);
 
+const int NUM_CUBE_FACES = 6;
+// A camera at the position looking through one of the six faces of a cube
+// map. Square images from makeCameraIntrinsics cover the whole face.
+CameraExtrinsics makeCubeFaceExtrinsics(const Vector4d& position, int face);
+
 Matrix4d imageFromCamera(const CameraIntrinsics& intrinsics);
 Matrix4d worldFromCamera(const CameraExtrinsics& coordinates);
 Matrix4d cameraFromWorld(const CameraExtrinsics& coordinates);
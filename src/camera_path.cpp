@@ -0,0 +1,40 @@
+#include "camera_path.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+bool loadCameraPath(const std::string& filepath, std::vector<CameraExtrinsics>& camera_path)
+{
+    auto file = std::ifstream(filepath);
+    if (!file) return false;
+    auto path = std::vector<CameraExtrinsics>{};
+    auto line = std::string{};
+    while (std::getline(file, line))
+    {
+        const auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+        auto stream = std::istringstream(line);
+        auto extrinsics = CameraExtrinsics{};
+        if (!(stream >> extrinsics.x >> extrinsics.y >> extrinsics.z >> extrinsics.yaw >> extrinsics.pitch))
+            return false;
+        path.push_back(extrinsics);
+    }
+    camera_path = path;
+    return true;
+}
+
+bool saveCameraPath(const std::string& filepath, const std::vector<CameraExtrinsics>& camera_path)
+{
+    auto file = std::ofstream(filepath);
+    // Writes enough digits to read back the same doubles.
+    file << std::setprecision(std::numeric_limits<double>::max_digits10);
+    file << "# x y z yaw pitch\n";
+    for (const auto& extrinsics : camera_path)
+    {
+        file << extrinsics.x << " " << extrinsics.y << " " << extrinsics.z << " "
+             << extrinsics.yaw << " " << extrinsics.pitch << "\n";
+    }
+    return file.good();
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "camera.hpp"
+
+// A camera path is a text file with the extrinsics of one frame per line,
+// as x y z yaw pitch. Empty lines and lines starting with # are skipped.
+bool loadCameraPath(const std::string& filepath, std::vector<CameraExtrinsics>& camera_path);
+bool saveCameraPath(const std::string& filepath, const std::vector<CameraExtrinsics>& camera_path);
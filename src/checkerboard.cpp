@@ -0,0 +1,131 @@
+#include "checkerboard.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <Eigen/LU>
+
+#include "camera.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+
+// A reprojected pixel is only used if its disparity is within this
+// fraction of the disparity that the previous frame has at the same point,
+// so pixels that were hidden or are at an edge are interpolated instead.
+const double DISPARITY_TOLERANCE = 0.05;
+
+// Averages each of the four 8-bit channels, by summing the even and odd
+// channels in 16-bit lanes.
+Pixel averageColor(Pixel a, Pixel b, Pixel c, Pixel d)
+{
+    const auto mask = Pixel{0x00FF00FF};
+    const auto rounding = Pixel{0x00020002};
+    const auto even = (a & mask) + (b & mask) + (c & mask) + (d & mask) + rounding;
+    const auto odd = ((a >> 8) & mask) + ((b >> 8) & mask) + ((c >> 8) & mask) + ((d >> 8) & mask) + rounding;
+    return ((even >> 2) & mask) | (((odd >> 2) & mask) << 8);
+}
+
+} // namespace
+
+CheckerboardReconstruction::CheckerboardReconstruction()
+    : history_(0, 0)
+    , previous_image_from_world_(Matrix4d::Identity())
+    , parity_(0)
+{}
+
+CheckerboardStatistics CheckerboardReconstruction::reconstruct(Pixels& pixels, const Environment& environment)
+{
+    using namespace std;
+
+    const auto image_from_world = Matrix4d{
+        imageFromCamera(environment.intrinsics) * cameraFromWorld(environment.extrinsics) };
+    // Also handles a change of resolution, since the previous intrinsics
+    // are part of the previous matrix.
+    const auto previous_from_current = Matrix4d{ previous_image_from_world_ * image_from_world.inverse() };
+    const auto width = pixels.width;
+    const auto height = pixels.height;
+    const auto has_history = history_.size() > 0;
+    const auto history_width = static_cast<double>(history_.width);
+    const auto history_height = static_cast<double>(history_.height);
+    const auto colors = pixels.colors.data();
+    const auto disparities = pixels.disparities.data();
+    const auto history_colors = history_.colors.data();
+    const auto history_disparities = history_.disparities.data();
+
+    auto num_reprojected = vector<size_t>(height, 0);
+    auto num_interpolated = vector<size_t>(height, 0);
+    if (width < 2 || height < 2)
+        return CheckerboardStatistics{};
+    parallelFor(height, [&](size_t y)
+    {
+        // Pixels at the border use their inner neighbor twice.
+        const auto row = y * width;
+        const auto row_up = (y > 0 ? y - 1 : y + 1) * width;
+        const auto row_down = (y + 1 < height ? y + 1 : y - 1) * width;
+        // The pixels of the other parity are the ones that were drawn.
+        const auto x_begin = (y + parity_ + 1) % 2;
+        // The reprojection is affine in x, y and disparity before the
+        // division, so it is stepped along the row.
+        auto p_row = Vector4d{ previous_from_current.col(3) +
+            double(x_begin) * previous_from_current.col(0) + double(y) * previous_from_current.col(1) };
+        const auto p_dx = Vector4d{ 2.0 * previous_from_current.col(0) };
+        const auto p_disparity = Vector4d{ previous_from_current.col(2) };
+        auto reprojected = size_t{0};
+        for (auto x = x_begin; x < width; x += 2, p_row += p_dx)
+        {
+            const auto left = row + (x > 0 ? x - 1 : x + 1);
+            const auto right = row + (x + 1 < width ? x + 1 : x - 1);
+            const auto up = row_up + x;
+            const auto down = row_down + x;
+            const auto index = row + x;
+            // Disparity is linear in image space on a planar surface, so the
+            // average of the neighbors is exact inside triangles.
+            const auto disparity = 0.25 * (disparities[left] + disparities[right] + disparities[up] + disparities[down]);
+            disparities[index] = disparity;
+
+            if (has_history && disparity > 0.0)
+            {
+                const auto p = Vector4d{ p_row + disparity * p_disparity };
+                if (p(3) > 0.0)
+                {
+                    const auto w = 1.0 / p(3);
+                    const auto previous_disparity = p(2) * w;
+                    const auto previous_x = floor(p(0) * w + 0.5);
+                    const auto previous_y = floor(p(1) * w + 0.5);
+                    if (0.0 <= previous_x && previous_x < history_width &&
+                        0.0 <= previous_y && previous_y < history_height)
+                    {
+                        const auto previous_index = size_t(previous_y) * history_.width + size_t(previous_x);
+                        const auto difference = abs(history_disparities[previous_index] - previous_disparity);
+                        if (difference <= DISPARITY_TOLERANCE * previous_disparity)
+                        {
+                            colors[index] = history_colors[previous_index];
+                            ++reprojected;
+                            continue;
+                        }
+                    }
+                }
+            }
+            colors[index] = averageColor(colors[left], colors[right], colors[up], colors[down]);
+        }
+        num_reprojected[y] = reprojected;
+        num_interpolated[y] = (width - x_begin + 1) / 2 - reprojected;
+    });
+
+    history_.resize(width, height);
+    copy(pixels.colors.begin(), pixels.colors.end(), history_.colors.begin());
+    copy(pixels.disparities.begin(), pixels.disparities.end(), history_.disparities.begin());
+    previous_image_from_world_ = image_from_world;
+    parity_ = 1 - parity_;
+
+    auto statistics = CheckerboardStatistics{};
+    for (size_t y = 0; y < height; ++y)
+    {
+        statistics.num_reprojected += num_reprojected[y];
+        statistics.num_interpolated += num_interpolated[y];
+    }
+    return statistics;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "drawing.hpp"
+#include "vector_space.hpp"
+
+struct CheckerboardStatistics
+{
+    size_t num_reprojected = 0;
+    size_t num_interpolated = 0;
+};
+
+// Fills in the half of the pixels that were not drawn in a checkerboard
+// frame. They are reprojected from the previous frame using their
+// disparity and the camera movement, or interpolated from their drawn
+// neighbors where the previous frame does not match.
+class CheckerboardReconstruction
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    CheckerboardReconstruction();
+    // The checkerboard parity to draw the next frame with.
+    int parity() const { return parity_; }
+    // Reconstructs the pixels that were not drawn with parity() and keeps
+    // the frame for the next one, which is drawn with the other parity.
+    CheckerboardStatistics reconstruct(Pixels& pixels, const Environment& environment);
+private:
+    Pixels history_;
+    Matrix4d previous_image_from_world_;
+    int parity_;
+};
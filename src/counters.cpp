@@ -0,0 +1,57 @@
+#include "counters.hpp"
+
+namespace
+{
+
+// Applies the operation to each pair of counters.
+template<typename Operation>
+void combine(PipelineCounters& a, const PipelineCounters& b, Operation operation)
+{
+    operation(a.vertices, b.vertices);
+    operation(a.shapes_in, b.shapes_in);
+    operation(a.shapes_outside_frustum, b.shapes_outside_frustum);
+    operation(a.triangles_in, b.triangles_in);
+    operation(a.triangles_outside_frustum, b.triangles_outside_frustum);
+    operation(a.triangles_behind_camera, b.triangles_behind_camera);
+    operation(a.triangles_off_screen, b.triangles_off_screen);
+    operation(a.triangles_zero_area, b.triangles_zero_area);
+    operation(a.pixels_tested, b.pixels_tested);
+    operation(a.pixels_covered, b.pixels_covered);
+    operation(a.depth_test_passes, b.depth_test_passes);
+    operation(a.depth_test_failures, b.depth_test_failures);
+    operation(a.shader_invocations, b.shader_invocations);
+    operation(a.frame_pixels, b.frame_pixels);
+}
+
+} // namespace
+
+PipelineCounters& PipelineCounters::operator+=(const PipelineCounters& other)
+{
+    combine(*this, other, [](uint64_t& a, uint64_t b) { a += b; });
+    return *this;
+}
+
+PipelineCounters& PipelineCounters::operator-=(const PipelineCounters& other)
+{
+    combine(*this, other, [](uint64_t& a, uint64_t b) { a -= b; });
+    return *this;
+}
+
+void printPipelineCounters(std::ostream& stream, const PipelineCounters& counters)
+{
+    const auto& c = counters;
+    stream << "vertices                  : " << c.vertices << std::endl;
+    stream << "shapes in                 : " << c.shapes_in << std::endl;
+    stream << "shapes outside frustum    : " << c.shapes_outside_frustum << std::endl;
+    stream << "triangles in              : " << c.triangles_in << std::endl;
+    stream << "triangles outside frustum : " << c.triangles_outside_frustum << std::endl;
+    stream << "triangles behind camera   : " << c.triangles_behind_camera << std::endl;
+    stream << "triangles off screen      : " << c.triangles_off_screen << std::endl;
+    stream << "triangles zero area       : " << c.triangles_zero_area << std::endl;
+    stream << "pixels tested             : " << c.pixels_tested << std::endl;
+    stream << "pixels covered            : " << c.pixels_covered << std::endl;
+    stream << "depth test passes         : " << c.depth_test_passes << std::endl;
+    stream << "depth test failures       : " << c.depth_test_failures << std::endl;
+    stream << "shader invocations        : " << c.shader_invocations << std::endl;
+    stream << "overdraw                  : " << c.overdraw() << std::endl;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+
+// Counts the work of each stage of vertexShader and drawTriangles on the
+// calling thread, if RASTERIZER_COUNTERS is defined. Otherwise the counters
+// compile to nothing. parallelFor adds the counts of its workers to the
+// thread that called it.
+struct PipelineCounters
+{
+    uint64_t vertices = 0;
+    uint64_t shapes_in = 0;
+    uint64_t shapes_outside_frustum = 0;
+    // Triangles of the selected levels of detail of the shapes in the
+    // frustum, and all triangles of the shapes outside it.
+    uint64_t triangles_in = 0;
+    uint64_t triangles_outside_frustum = 0;
+    uint64_t triangles_behind_camera = 0;
+    uint64_t triangles_off_screen = 0;
+    uint64_t triangles_zero_area = 0;
+    // Pixels in the bounding boxes of the rasterized triangles.
+    uint64_t pixels_tested = 0;
+    uint64_t pixels_covered = 0;
+    uint64_t depth_test_passes = 0;
+    uint64_t depth_test_failures = 0;
+    // Calls of the surface shader, which are fewer than the depth test
+    // passes for coarse shading rates.
+    uint64_t shader_invocations = 0;
+    uint64_t frame_pixels = 0;
+
+    // Depth test passes per pixel of the frames.
+    double overdraw() const { return frame_pixels ? double(depth_test_passes) / frame_pixels : 0.0; }
+    PipelineCounters& operator+=(const PipelineCounters& other);
+    PipelineCounters& operator-=(const PipelineCounters& other);
+};
+
+#ifdef RASTERIZER_COUNTERS
+const bool PIPELINE_COUNTERS_ENABLED = true;
+#define COUNT_PIPELINE(counter, n) (pipelineCounters().counter += (n))
+#else
+const bool PIPELINE_COUNTERS_ENABLED = false;
+#define COUNT_PIPELINE(counter, n) ((void)0)
+#endif
+
+inline PipelineCounters& pipelineCounters()
+{
+    thread_local auto counters = PipelineCounters{};
+    return counters;
+}
+
+inline void resetPipelineCounters()
+{
+    pipelineCounters() = PipelineCounters{};
+}
+
+// Keeps the counts of the work in its scope, like a shadow map pass, out
+// of the counters of the calling thread.
+class UncountedScope
+{
+public:
+    UncountedScope() : saved_(pipelineCounters()) {}
+    ~UncountedScope() { pipelineCounters() = saved_; }
+    UncountedScope(const UncountedScope&) = delete;
+    UncountedScope& operator=(const UncountedScope&) = delete;
+private:
+    PipelineCounters saved_;
+};
+
+void printPipelineCounters(std::ostream& stream, const PipelineCounters& counters);
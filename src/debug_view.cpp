@@ -0,0 +1,70 @@
+#include "debug_view.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+
+// Counts at and above these are white.
+const double MAX_OVERDRAW = 8.0;
+const double MAX_SHADER_COST = 16.0;
+const double MAX_TRIANGLES_PER_TILE = 64.0;
+
+Pixel heatmapColor(double fraction)
+{
+    const Pixel colors[][3] = {
+        { 0, 0, 0 }, { 0, 0, 255 }, { 0, 255, 0 }, { 255, 255, 0 }, { 255, 0, 0 }, { 255, 255, 255 } };
+    const auto num_steps = sizeof(colors) / sizeof(colors[0]) - 1;
+    const auto position = std::min(std::max(fraction, 0.0), 1.0) * num_steps;
+    const auto step = std::min(static_cast<size_t>(position), num_steps - 1);
+    const auto t = position - step;
+    auto color = Pixel{0xFF000000};
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        const auto value = (1.0 - t) * colors[step][channel] + t * colors[step + 1][channel];
+        color |= static_cast<Pixel>(value + 0.5) << (16 - 8 * channel);
+    }
+    return color;
+}
+
+} // namespace
+
+void DebugCounts::reset(DebugView new_view, size_t new_width, size_t height)
+{
+    view = new_view;
+    width = new_width;
+    num_tiles_x = (width + DEBUG_VIEW_TILE_SIZE - 1) / DEBUG_VIEW_TILE_SIZE;
+    const auto num_tiles_y = (height + DEBUG_VIEW_TILE_SIZE - 1) / DEBUG_VIEW_TILE_SIZE;
+    pixel_counts.assign(width * height, 0);
+    tile_counts.assign(num_tiles_x * num_tiles_y, 0);
+    tile_triangles.assign(num_tiles_x * num_tiles_y, std::numeric_limits<size_t>::max());
+}
+
+const char* debugViewName(DebugView view)
+{
+    switch (view)
+    {
+    case DEBUG_VIEW_OVERDRAW: return "overdraw";
+    case DEBUG_VIEW_SHADER_COST: return "shader cost";
+    case DEBUG_VIEW_TRIANGLES_PER_TILE: return "triangles per tile";
+    default: return "shaded";
+    }
+}
+
+void drawDebugView(Pixels& pixels, const DebugCounts& counts)
+{
+    if (counts.view == DEBUG_VIEW_TRIANGLES_PER_TILE)
+    {
+        for (size_t i = 0; i < pixels.size(); ++i)
+        {
+            const auto tile = i / pixels.width / DEBUG_VIEW_TILE_SIZE * counts.num_tiles_x +
+                i % pixels.width / DEBUG_VIEW_TILE_SIZE;
+            pixels.colors[i] = heatmapColor(counts.tile_counts[tile] / MAX_TRIANGLES_PER_TILE);
+        }
+        return;
+    }
+    const auto max_count = counts.view == DEBUG_VIEW_OVERDRAW ? MAX_OVERDRAW : MAX_SHADER_COST;
+    for (size_t i = 0; i < pixels.size(); ++i)
+        pixels.colors[i] = heatmapColor(counts.pixel_counts[i] / max_count);
+}
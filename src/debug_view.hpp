@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "drawing.hpp"
+
+const size_t DEBUG_VIEW_TILE_SIZE = 16;
+
+// What drawTriangles counts while drawing a debug view, which replaces the
+// colors when the frame is done.
+struct DebugCounts
+{
+    DebugView view = DEBUG_VIEW_NONE;
+    size_t width = 0;
+    size_t num_tiles_x = 0;
+    // Depth tests or shading cost of each pixel.
+    std::vector<uint32_t> pixel_counts;
+    // Triangles that cover a pixel of each tile, and the last one counted.
+    std::vector<uint32_t> tile_counts;
+    std::vector<size_t> tile_triangles;
+
+    void reset(DebugView new_view, size_t new_width, size_t height);
+    // Called for each pixel of the triangle that reaches the depth test.
+    void countDepthTest(size_t index, size_t triangle)
+    {
+        if (view == DEBUG_VIEW_OVERDRAW)
+        {
+            ++pixel_counts[index];
+        }
+        else if (view == DEBUG_VIEW_TRIANGLES_PER_TILE)
+        {
+            const auto tile = index / width / DEBUG_VIEW_TILE_SIZE * num_tiles_x + index % width / DEBUG_VIEW_TILE_SIZE;
+            if (tile_triangles[tile] != triangle)
+            {
+                tile_triangles[tile] = triangle;
+                ++tile_counts[tile];
+            }
+        }
+    }
+    void countShading(size_t index, uint32_t cost)
+    {
+        if (view == DEBUG_VIEW_SHADER_COST)
+            pixel_counts[index] += cost;
+    }
+};
+
+const char* debugViewName(DebugView view);
+// Writes the counts as heatmap colors from black over blue, green, yellow
+// and red to white at the maximum count of the view.
+void drawDebugView(Pixels& pixels, const DebugCounts& counts);
@@ -1,10 +1,19 @@
 #include <algorithm>
+#include <cassert>
+#include <limits>
 
 #include <Eigen/Core>
 
 #include "algorithm.hpp"
+#include "counters.hpp"
+#include "debug_view.hpp"
 #include "drawing.hpp"
 #include "drawing_template.hpp"
+#include "parallel.hpp"
+#include "shading_rate.hpp"
+
+// Largest geometric error of a level of detail on screen, in pixels.
+const auto MAX_LOD_PIXEL_ERROR = 0.5;
 
 Light makeLight()
 {
@@ -16,7 +25,83 @@ Light makeLight()
 
 bool isBehindCamera(const Vector4d& v0, const Vector4d& v1, const Vector4d& v2)
 {
-	return v0(2) <= 0 || v1(2) <= 0 || v2(2) <= 0;
+    // Vertices in the plane of the camera have infinite or undefined disparity.
+    const auto is_in_front = [](const Vector4d& v)
+    {
+        return 0 < v(2) && v(2) < std::numeric_limits<double>::infinity();
+    };
+	return !(is_in_front(v0) && is_in_front(v1) && is_in_front(v2));
+}
+
+bool isOutsideFrustum(const Vector4d& box_min, const Vector4d& box_max,
+    const Matrix4d& image_from_world, const CameraIntrinsics& intrinsics)
+{
+    // Before the perspective division a visible point p satisfies
+    // 0 < p(3), 0 <= p(0) <= width * p(3) and 0 <= p(1) <= height * p(3).
+    // The box is outside if all its corners are outside the same plane.
+    const auto width = static_cast<double>(intrinsics.width);
+    const auto height = static_cast<double>(intrinsics.height);
+    auto outside_near   = true;
+    auto outside_left   = true;
+    auto outside_right  = true;
+    auto outside_top    = true;
+    auto outside_bottom = true;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const auto x = corner & 1 ? box_max(0) : box_min(0);
+        const auto y = corner & 2 ? box_max(1) : box_min(1);
+        const auto z = corner & 4 ? box_max(2) : box_min(2);
+        const auto p = Vector4d{ image_from_world * Vector4d{ x, y, z, 1.0 } };
+        outside_near   = outside_near   && p(3) <= 0.0;
+        outside_left   = outside_left   && p(0) < 0.0;
+        outside_right  = outside_right  && p(0) > width * p(3);
+        outside_top    = outside_top    && p(1) < 0.0;
+        outside_bottom = outside_bottom && p(1) > height * p(3);
+    }
+    return outside_near || outside_left || outside_right || outside_top || outside_bottom;
+}
+
+double distanceToBox(const Vector4d& point, const Vector4d& box_min, const Vector4d& box_max)
+{
+    const auto outside = Vector4d{ (box_min - point).cwiseMax(point - box_max).cwiseMax(0.0) };
+    return outside.head<3>().norm();
+}
+
+bool isInFrontOfCamera(const Vector4d& box_min, const Vector4d& box_max, const Matrix4d& camera_from_world)
+{
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const auto x = corner & 1 ? box_max(0) : box_min(0);
+        const auto y = corner & 2 ? box_max(1) : box_min(1);
+        const auto z = corner & 4 ? box_max(2) : box_min(2);
+        if (camera_from_world.row(2).dot(Vector4d{ x, y, z, 1.0 }) <= 0.0)
+            return false;
+    }
+    return true;
+}
+
+// Picks the coarsest level of detail whose geometric error projects to at
+// most MAX_LOD_PIXEL_ERROR pixels at the closest point of the bounding box.
+// Triangles that reach behind the camera are skipped instead of clipped,
+// so shapes that are not entirely in front of the camera use the full level.
+size_t selectLod(const Shapes& shapes, size_t shape, const Matrix4d& camera_from_world,
+    const CameraExtrinsics& extrinsics, const CameraIntrinsics& intrinsics)
+{
+    auto lod = shapes.lod_begins[shape];
+    const auto& box_min = shapes.bounding_box_mins[shape];
+    const auto& box_max = shapes.bounding_box_maxs[shape];
+    if (!isInFrontOfCamera(box_min, box_max, camera_from_world))
+        return lod;
+
+    const auto camera_position = Vector4d{ extrinsics.x, extrinsics.y, extrinsics.z, 1.0 };
+    const auto distance = distanceToBox(camera_position, box_min, box_max);
+    const auto focal_length = std::max(intrinsics.fx, intrinsics.fy);
+    for (auto level = lod + 1; level < shapes.lod_ends[shape]; ++level)
+    {
+        if (shapes.lod_errors[level] * focal_length <= MAX_LOD_PIXEL_ERROR * distance)
+            lod = level;
+    }
+    return lod;
 }
 
 void vertexShader(Vertices& vertices, const Environment& environment)
@@ -25,6 +110,30 @@ void vertexShader(Vertices& vertices, const Environment& environment)
     const auto image_from_camera = imageFromCamera(environment.intrinsics);
     const auto camera_from_world = cameraFromWorld(environment.extrinsics);
     const auto image_from_world = Matrix4d{ image_from_camera * camera_from_world };
+    COUNT_PIPELINE(vertices, num_vertices);
+
+    if (vertices.isQuantized())
+    {
+        // The dequantization of each chunk is folded into its transform.
+        const auto& quantized = vertices.quantized;
+        for (size_t chunk = 0; chunk < quantized.numChunks(); ++chunk)
+        {
+            const auto image_from_quantized = Matrix4d{ image_from_world * worldFromQuantized(quantized, chunk) };
+            const auto begin = chunk * QUANTIZATION_CHUNK_SIZE;
+            const auto end = std::min(num_vertices, begin + QUANTIZATION_CHUNK_SIZE);
+            for (auto i = begin; i < end; ++i)
+            {
+                const auto position_quantized = Vector4d{
+                    double(quantized.positions[3 * i + 0]),
+                    double(quantized.positions[3 * i + 1]),
+                    double(quantized.positions[3 * i + 2]),
+                    1.0 };
+                const auto position_image = Vector4d{ image_from_quantized * position_quantized };
+                vertices.positions_image[i] = position_image / position_image(3);
+            }
+        }
+        return;
+    }
 
 	for (size_t i = 0; i < num_vertices; ++i)
 	{
@@ -34,7 +143,14 @@ void vertexShader(Vertices& vertices, const Environment& environment)
 	}
 }
 
-Uint32 packColorArgb(Uint32 a, Uint32 r, Uint32 g, Uint32 b)
+void quantizeVertices(Vertices& vertices)
+{
+    vertices.quantized = quantizeAttributes(vertices.positions_world, vertices.positions_texture);
+    Vectors4d{}.swap(vertices.positions_world);
+    Vectors2d{}.swap(vertices.positions_texture);
+}
+
+Pixel packColorArgb(Pixel a, Pixel r, Pixel g, Pixel b)
 {
 	return (a << 24) | (r << 16) | (g << 8) | (b << 0);
 }
@@ -51,66 +167,230 @@ void basicPixelShader(const Vertex& vertex, Pixels& pixels, size_t index)
 	// TODO: try if defered rendering is faster.
     if (disparity <= pixels.disparities[index]) return;
 
-	const Uint32 c = static_cast<Uint32>(clamp(500 * disparity, 0.0, 255.0));
+	const Pixel c = static_cast<Pixel>(clamp(500 * disparity, 0.0, 255.0));
 	pixels.colors[index] = packColorArgb(255, c, c, c);
 	pixels.disparities[index] = disparity;
 }
 
-Uint32 clampColor(double c)
+Pixel clampColor(double c)
 {
-    return static_cast<Uint32>(clamp(c, 0.0, 255.0));
+    return static_cast<Pixel>(clamp(c, 0.0, 255.0));
 }
 
-struct PixelEnvironment
+// What a surface shader needs besides the interpolated vertex.
+struct SurfaceInputs
 {
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-    const Texture* surface_texture;
-    Vector4d surface_normal_world;
+    Pixels* pixels;
+    const Vectors4d* positions_image;
+    const Texture* texture;
+    const Lightmaps* lightmaps;
+    const ShadowMap* shadow_map;
     Vector4d light_position_world;
-    Vector4d light_power;
+    size_t triangle;
+    int checkerboard_parity;
+    ShadingRates* shading_rates;
+    ShadingRate material_shading_rate;
+    DebugCounts* debug_counts;
 };
 
-struct PixelShader
+// How the triangles of a material are shaded. Untextured surfaces show
+// their depth, and textured ones are lit from the lightmaps, or per pixel
+// until there are lightmaps.
+enum Surface
 {
-    Pixels* pixels;
-    PixelEnvironment pixel_environment;
-    void operator()(const Vertex& vertex, size_t index) const
+    SURFACE_DEPTH,
+    SURFACE_LIGHTMAPPED,
+    SURFACE_PER_PIXEL_LIT,
+};
+
+// A pixel shader permutation. After the barycentric coordinates and the
+// disparity, a permutation only interpolates the channels it uses: the
+// texture coordinates U and V if TEXTURED, and either the world position
+// X, Y and Z for per pixel lighting, or the barycentric coordinates S and
+// T for lightmap lookups. All channels except the barycentric coordinates
+// are multiplied by the disparity.
+template<Surface SURFACE>
+struct SurfaceShader : SurfaceInputs
+{
+    static constexpr bool TEXTURED = SURFACE != SURFACE_DEPTH;
+    static constexpr bool LIGHTMAPPED = SURFACE == SURFACE_LIGHTMAPPED;
+    static constexpr bool WORLD_POSITION = SURFACE == SURFACE_PER_PIXEL_LIT;
+    enum { BARY0, BARY1, BARY2, DISPARITY };
+    enum { U = DISPARITY + 1, V };
+    enum { S = TEXTURED ? V + 1 : DISPARITY + 1, T };
+    enum { X = LIGHTMAPPED ? T + 1 : S, Y, Z };
+    enum { SIZE = WORLD_POSITION ? Z + 1 : X };
+    using Vertex = Eigen::Matrix<double, SIZE, 1>;
+
+    // The vertex at corner k of a triangle.
+    static Vertex makeVertex(const Vertices& vertices, const Vectors4d& positions_image, size_t i, int k)
     {
-        using namespace vertex_index;
+        const auto disparity = positions_image[i](2);
+        auto vertex = Vertex{ Vertex::Zero() };
+        vertex(BARY0 + k) = 1.0;
+        vertex(DISPARITY) = disparity;
+        if constexpr (TEXTURED)
+        {
+            const auto t = vertices.positionTexture(i);
+            vertex(U) = t(0) * disparity;
+            vertex(V) = t(1) * disparity;
+        }
+        if constexpr (LIGHTMAPPED)
+        {
+            if (k == 1) vertex(S) = disparity;
+            if (k == 2) vertex(T) = disparity;
+        }
+        if constexpr (WORLD_POSITION)
+        {
+            const auto p = vertices.positionWorld(i);
+            vertex(X) = p(0) * disparity;
+            vertex(Y) = p(1) * disparity;
+            vertex(Z) = p(2) * disparity;
+        }
+        return vertex;
+    }
 
+    void operator()(const Vertex& vertex, size_t index) const
+    {
         if (vertex(BARY0) < 0.0 || 1.0 < vertex(BARY0)) return;
         if (vertex(BARY1) < 0.0 || 1.0 < vertex(BARY1)) return;
         if (vertex(BARY2) < 0.0 || 1.0 < vertex(BARY2)) return;
+        COUNT_PIPELINE(pixels_covered, 1);
+        if (debug_counts)
+            debug_counts->countDepthTest(index, triangle);
 
         const double disparity = vertex(DISPARITY);
         // TODO: try if defered rendering is faster.
-        if (disparity <= pixels->disparities[index]) return;
-
-        const Uint32 c = clampColor(255 * 2 * disparity);
-        pixels->colors[index] = packColorArgb(255, c, c, c);
+        if (disparity <= pixels->disparities[index])
+        {
+            COUNT_PIPELINE(depth_test_failures, 1);
+            return;
+        }
+        COUNT_PIPELINE(depth_test_passes, 1);
         pixels->disparities[index] = disparity;
 
-        if (pixel_environment.surface_texture->empty()) return;
-
-        const auto x = vertex(X) / disparity;
-        const auto y = vertex(Y) / disparity;
-        const auto z = vertex(Z) / disparity;
+        if (!shading_rates)
+        {
+            pixels->colors[index] = shadeAt(vertex, disparity, index);
+            return;
+        }
+        // The first visible pixel of the triangle in a coarse block is
+        // shaded, and its color is reused for the rest of the block.
+        const auto width = pixels->width;
+        const auto x = index % width;
+        const auto y = index / width;
+        const auto rate = std::max(shading_rates->tile(x, y), material_shading_rate);
+        if (rate == SHADING_RATE_1X1)
+        {
+            pixels->colors[index] = shadeAt(vertex, disparity, index);
+            return;
+        }
+        const auto block = (y - y % shadingRateHeight(rate)) * width + x - x % shadingRateWidth(rate);
+        if (shading_rates->block_triangles[block] != triangle)
+        {
+            shading_rates->block_triangles[block] = triangle;
+            shading_rates->block_colors[block] = shadeAt(vertex, disparity, index);
+        }
+        pixels->colors[index] = shading_rates->block_colors[block];
+    }
 
-        const auto u = vertex(U) / disparity;
-        const auto v = vertex(V) / disparity;
-        const auto position_world = Vector4d{x, y, z, 1};
+    // One unit per invocation, per texture or lightmap lookup, per pixel
+    // light and per shadow map lookup, for the shader cost debug view.
+    uint32_t shadingCost() const
+    {
+        return 1 + TEXTURED + (LIGHTMAPPED || WORLD_POSITION) + (WORLD_POSITION && !shadow_map->empty());
+    }
 
-        //const auto light = disparity;
-        const auto light = 16.0 / (position_world - pixel_environment.light_position_world).squaredNorm();
+    Pixel shadeAt(const Vertex& vertex, double disparity, size_t index) const
+    {
+        if (debug_counts)
+            debug_counts->countShading(index, shadingCost());
+        return shade(vertex, disparity);
+    }
 
-        const auto color = pixel_environment.surface_texture->sample(u, v);
-        const auto red   = clampColor(light * color(RED));
-        const auto green = clampColor(light * color(GREEN));
-        const auto blue  = clampColor(light * color(BLUE));
-        pixels->colors[index] = packColorArgb(255, red, green, blue);
+    Pixel shade(const Vertex& vertex, double disparity) const
+    {
+        COUNT_PIPELINE(shader_invocations, 1);
+        if constexpr (SURFACE == SURFACE_DEPTH)
+        {
+            const Pixel c = clampColor(255 * 2 * disparity);
+            return packColorArgb(255, c, c, c);
+        }
+        else
+        {
+            auto light = 1.0;
+            if constexpr (WORLD_POSITION)
+            {
+                const auto position_world = Vector4d{
+                    vertex(X) / disparity, vertex(Y) / disparity, vertex(Z) / disparity, 1.0 };
+                light = lightIntensity(position_world, light_position_world);
+                if (!shadow_map->empty())
+                    light *= shadow_map->lightFraction(position_world);
+            }
+            if constexpr (LIGHTMAPPED)
+            {
+                light = lightmaps->sample(triangle, vertex(S) / disparity, vertex(T) / disparity);
+            }
+            auto color = Vector4d{ 255.0, 255.0, 255.0, 255.0 };
+            if constexpr (TEXTURED)
+            {
+                color = texture->sample(vertex(U) / disparity, vertex(V) / disparity);
+            }
+            const auto red   = clampColor(light * color(RED));
+            const auto green = clampColor(light * color(GREEN));
+            const auto blue  = clampColor(light * color(BLUE));
+            return packColorArgb(255, red, green, blue);
+        }
     }
 };
 
+template<Surface SURFACE>
+void drawTriangleRange(const Vertices& vertices, const Triangles& triangles,
+    size_t begin, size_t end, const SurfaceInputs& inputs)
+{
+    using Shader = SurfaceShader<SURFACE>;
+    auto shader = Shader{ inputs };
+    const auto& positions_image = *inputs.positions_image;
+    const auto width = inputs.pixels->width;
+    const auto height = inputs.pixels->height;
+    for (auto i = begin; i < end; ++i)
+    {
+        const auto i0 = triangles.indices0[i];
+        const auto i1 = triangles.indices1[i];
+        const auto i2 = triangles.indices2[i];
+
+        const auto& v0 = positions_image[i0];
+        const auto& v1 = positions_image[i1];
+        const auto& v2 = positions_image[i2];
+
+        if (isBehindCamera(v0, v1, v2))
+        {
+            COUNT_PIPELINE(triangles_behind_camera, 1);
+            continue;
+        }
+
+        shader.triangle = i;
+        renderTriangleTemplate(v0, v1, v2,
+            Shader::makeVertex(vertices, positions_image, i0, 0),
+            Shader::makeVertex(vertices, positions_image, i1, 1),
+            Shader::makeVertex(vertices, positions_image, i2, 2),
+            width, height, shader, inputs.checkerboard_parity);
+    }
+}
+
+// Picks the shader permutation once for a range of triangles.
+void drawTriangleRange(const Vertices& vertices, const Triangles& triangles,
+    size_t begin, size_t end, const SurfaceInputs& inputs, Surface surface)
+{
+    switch (surface)
+    {
+    case SURFACE_DEPTH:         drawTriangleRange<SURFACE_DEPTH        >(vertices, triangles, begin, end, inputs); break;
+    case SURFACE_LIGHTMAPPED:   drawTriangleRange<SURFACE_LIGHTMAPPED  >(vertices, triangles, begin, end, inputs); break;
+    case SURFACE_PER_PIXEL_LIT: drawTriangleRange<SURFACE_PER_PIXEL_LIT>(vertices, triangles, begin, end, inputs); break;
+    }
+}
+
 void drawPoint(Pixels& pixels, const Vector4d& vertex_image)
 {
     const auto x = static_cast<int>(vertex_image.x());
@@ -140,80 +420,186 @@ Vector4d computeNormal(const Vector4d& v0, const Vector4d& v1, const Vector4d& v
     return Vector4d::Zero();
 }
 
-void drawTriangles(Pixels& pixels, const Vertices& vertices,
-    const Triangles& triangles, const Textures& textures, const Environment& environment)
+// Culls the shape and adds its triangles at the level of detail of the
+// camera to the ranges, unless it is outside the frustum.
+void addTriangleRange(const Shapes& shapes, size_t s,
+    const Matrix4d& camera_from_world, const Matrix4d& image_from_world, const CameraIntrinsics& intrinsics, const CameraExtrinsics& extrinsics, TriangleRanges& ranges)
 {
-	const auto num_triangles = triangles.size();
+    COUNT_PIPELINE(shapes_in, 1);
+    if (isOutsideFrustum(shapes.bounding_box_mins[s], shapes.bounding_box_maxs[s], image_from_world, intrinsics))
+    {
+        COUNT_PIPELINE(shapes_outside_frustum, 1);
+        COUNT_PIPELINE(triangles_in, shapes.triangle_ends[s] - shapes.triangle_begins[s]);
+        COUNT_PIPELINE(triangles_outside_frustum, shapes.triangle_ends[s] - shapes.triangle_begins[s]);
+        return;
+    }
+
+    auto begin = shapes.triangle_begins[s];
+    auto end = shapes.triangle_ends[s];
+    if (!shapes.lod_begins.empty())
+    {
+        const auto lod = selectLod(shapes, s, camera_from_world, extrinsics, intrinsics);
+        begin = shapes.lod_triangle_begins[lod];
+        end = shapes.lod_triangle_ends[lod];
+    }
+    COUNT_PIPELINE(triangles_in, end - begin);
+    ranges.push_back(TriangleRange{ begin, end });
+}
 
+// Clears the pixels and draws the ranges of triangles with the image
+// positions of one camera.
+void drawTriangleRanges(Pixels& pixels, const Vertices& vertices, const Vectors4d& positions_image,
+    const Triangles& triangles, const Textures& textures, const TriangleRanges& ranges,
+    const Lightmaps& lightmaps, const ShadowMap& shadow_map, const Vector4d& light_position_world,
+    DebugView debug_view, const DrawOptions& options)
+{
 	fill(pixels.disparities, 0.0);
 	fill(pixels.colors, 0);
+    COUNT_PIPELINE(frame_pixels, pixels.size());
+
+    auto inputs = SurfaceInputs{};
+    inputs.pixels = &pixels;
+    inputs.positions_image = &positions_image;
+    inputs.lightmaps = &lightmaps;
+    inputs.shadow_map = &shadow_map;
+    inputs.light_position_world = light_position_world;
+    inputs.checkerboard_parity = options.checkerboard_parity;
+    inputs.shading_rates = nullptr;
+    const auto shading_rates = options.shading_rates;
+    if (shading_rates && shading_rates->width == pixels.width && shading_rates->height == pixels.height)
+    {
+        inputs.shading_rates = shading_rates;
+        shading_rates->block_triangles.resize(pixels.size());
+        shading_rates->block_colors.resize(pixels.size());
+        fill(shading_rates->block_triangles, std::numeric_limits<size_t>::max());
+    }
+    // The counts are only allocated for debug views, which are not timed.
+    auto debug_counts = DebugCounts{};
+    inputs.debug_counts = nullptr;
+    if (debug_view != DEBUG_VIEW_NONE)
+    {
+        debug_counts.reset(debug_view, pixels.width, pixels.height);
+        inputs.debug_counts = &debug_counts;
+    }
 
-    auto pixel_shader = PixelShader{};
-    auto vertex0 = Vertex();
-    auto vertex1 = Vertex();
-    auto vertex2 = Vertex();
+    const auto textured_surface = lightmaps.empty() ? SURFACE_PER_PIXEL_LIT : SURFACE_LIGHTMAPPED;
+    for (const auto& range : ranges)
+    {
+        auto run_begin = range.begin;
+        while (run_begin < range.end)
+        {
+            const auto texture_index = triangles.texture_indices[run_begin];
+            auto run_end = run_begin + 1;
+            while (run_end < range.end && triangles.texture_indices[run_end] == texture_index)
+                ++run_end;
+            inputs.texture = &textures[texture_index];
+            inputs.material_shading_rate = inputs.shading_rates ?
+                inputs.shading_rates->material(texture_index) : SHADING_RATE_1X1;
+            drawTriangleRange(vertices, triangles, run_begin, run_end, inputs,
+                inputs.texture->empty() ? SURFACE_DEPTH : textured_surface);
+            run_begin = run_end;
+        }
+    }
+    if (inputs.debug_counts)
+        drawDebugView(pixels, debug_counts);
+}
+
+void drawTriangles(Pixels& pixels, const Vertices& vertices, const Triangles& triangles,
+    const Shapes& shapes, const Textures& textures,
+    const PotentiallyVisibleSets& potentially_visible_sets, const Lightmaps& lightmaps,
+    const ShadowMap& shadow_map, const Environment& environment,
+    const DrawOptions& options)
+{
+    const auto camera_from_world = cameraFromWorld(environment.extrinsics);
+    const auto image_from_world = Matrix4d{ imageFromCamera(environment.intrinsics) * camera_from_world };
 
-    for (size_t i = 0; i < num_triangles; ++i)
+    auto ranges = TriangleRanges{};
+    const auto& pvs = potentially_visible_sets;
+    auto cell = size_t{};
+    if (!pvs.empty() && findCell(pvs, environment.extrinsics, cell))
     {
-        const auto i0 = triangles.indices0[i];
-        const auto i1 = triangles.indices1[i];
-        const auto i2 = triangles.indices2[i];
+        for (auto k = pvs.cell_begins[cell]; k < pvs.cell_begins[cell + 1]; ++k)
+            addTriangleRange(shapes, pvs.shapes[k], camera_from_world, image_from_world, environment.intrinsics, environment.extrinsics, ranges);
+    }
+    else
+    {
+        for (size_t s = 0; s < shapes.size(); ++s)
+            addTriangleRange(shapes, s, camera_from_world, image_from_world, environment.intrinsics, environment.extrinsics, ranges);
+    }
+    drawTriangleRanges(pixels, vertices, vertices.positions_image, triangles, textures, ranges,
+        lightmaps, shadow_map, environment.light.position_world, environment.debug_view, options);
+}
 
-        const auto& v0 = vertices.positions_image[i0];
-        const auto& v1 = vertices.positions_image[i1];
-        const auto& v2 = vertices.positions_image[i2];
-
-        const auto& t0 = vertices.positions_texture[i0];
-        const auto& t1 = vertices.positions_texture[i1];
-        const auto& t2 = vertices.positions_texture[i2];
-
-        const auto& p0 = vertices.positions_world[i0];
-        const auto& p1 = vertices.positions_world[i1];
-        const auto& p2 = vertices.positions_world[i2];
-
-		if (isBehindCamera(v0, v1, v2)) continue;
-
-		using namespace vertex_index;
-
-		vertex0(BARY0) = 1.0;
-		vertex0(BARY1) = 0.0;
-		vertex0(BARY2) = 0.0;
-		vertex0(DISPARITY) = v0(2);
-        vertex0(U) = t0(0) * v0(2);
-        vertex0(V) = t0(1) * v0(2);
-        vertex0(X) = p0(0) * v0(2);
-        vertex0(Y) = p0(1) * v0(2);
-        vertex0(Z) = p0(2) * v0(2);
-
-		vertex1(BARY0) = 0.0;
-		vertex1(BARY1) = 1.0;
-		vertex1(BARY2) = 0.0;
-		vertex1(DISPARITY) = v1(2);
-        vertex1(U) = t1(0) * v1(2);
-        vertex1(V) = t1(1) * v1(2);
-        vertex1(X) = p1(0) * v1(2);
-        vertex1(Y) = p1(1) * v1(2);
-        vertex1(Z) = p1(2) * v1(2);
-
-		vertex2(BARY0) = 0.0;
-		vertex2(BARY1) = 0.0;
-		vertex2(BARY2) = 1.0;
-		vertex2(DISPARITY) = v2(2);
-        vertex2(U) = t2(0) * v2(2);
-        vertex2(V) = t2(1) * v2(2);
-        vertex2(X) = p2(0) * v2(2);
-        vertex2(Y) = p2(1) * v2(2);
-        vertex2(Z) = p2(2) * v2(2);
-
-        const auto texture_index = triangles.texture_indices[i];
-        pixel_shader.pixels = &pixels;
-        pixel_shader.pixel_environment.surface_texture = &textures[texture_index];
-        pixel_shader.pixel_environment.light_position_world = environment.light.position_world;
-        pixel_shader.pixel_environment.light_power = environment.light.power;
-
-        //renderTriangleTemplate(pixels, basicPixelShader, v0, v1, v2, vertex0, vertex1, vertex2);
-        renderTriangleTemplate(
-            v0, v1, v2, vertex0, vertex1, vertex2,
-            pixels.width, pixels.height, pixel_shader);
+void drawViews(Views& views, const Vertices& vertices, const Triangles& triangles,
+    const Shapes& shapes, const Textures& textures,
+    const PotentiallyVisibleSets& potentially_visible_sets, const Lightmaps& lightmaps,
+    const ShadowMap& shadow_map, const Light& light)
+{
+    const auto num_views = views.size();
+    const auto num_vertices = vertices.size();
+    auto cameras_from_world = std::vector<Matrix4d, Eigen::aligned_allocator<Matrix4d>>(num_views);
+    auto images_from_world = std::vector<Matrix4d, Eigen::aligned_allocator<Matrix4d>>(num_views);
+    for (size_t v = 0; v < num_views; ++v)
+    {
+        auto& view = views[v];
+        for (size_t w = 0; w < v; ++w)
+            assert(!view.options.shading_rates || view.options.shading_rates != views[w].options.shading_rates);
+        cameras_from_world[v] = cameraFromWorld(view.extrinsics);
+        images_from_world[v] = imageFromCamera(view.intrinsics) * cameras_from_world[v];
+        view.positions_image.resize(num_vertices);
+        view.triangle_ranges.clear();
     }
+
+    // Each chunk of vertices is fetched, and dequantized if needed, once
+    // for all views, into a buffer that stays in the cache.
+    const auto chunk_size = size_t{512};
+    parallelFor((num_vertices + chunk_size - 1) / chunk_size, [&](size_t chunk)
+    {
+        Vector4d positions_world[chunk_size];
+        const auto begin = chunk * chunk_size;
+        const auto end = std::min(num_vertices, begin + chunk_size);
+        for (auto i = begin; i < end; ++i)
+            positions_world[i - begin] = vertices.positionWorld(i);
+        for (size_t v = 0; v < num_views; ++v)
+        {
+            const auto image_from_world = images_from_world[v];
+            auto& positions_image = views[v].positions_image;
+            for (auto i = begin; i < end; ++i)
+            {
+                const auto position_image = Vector4d{ image_from_world * positions_world[i - begin] };
+                positions_image[i] = position_image / position_image(3);
+            }
+        }
+    });
+    COUNT_PIPELINE(vertices, num_vertices * num_views);
+
+    // Each shape is visited once for all views, in the order of drawTriangles,
+    // since the potentially visible sets are sorted by shape.
+    const auto& pvs = potentially_visible_sets;
+    auto potentially_visible = std::vector<bool>(num_views * shapes.size(), true);
+    for (size_t v = 0; v < num_views; ++v)
+    {
+        auto cell = size_t{};
+        if (pvs.empty() || !findCell(pvs, views[v].extrinsics, cell))
+            continue;
+        std::fill(potentially_visible.begin() + v * shapes.size(), potentially_visible.begin() + (v + 1) * shapes.size(), false);
+        for (auto k = pvs.cell_begins[cell]; k < pvs.cell_begins[cell + 1]; ++k)
+            potentially_visible[v * shapes.size() + pvs.shapes[k]] = true;
+    }
+    for (size_t s = 0; s < shapes.size(); ++s)
+    {
+        for (size_t v = 0; v < num_views; ++v)
+        {
+            if (potentially_visible[v * shapes.size() + s])
+                addTriangleRange(shapes, s, cameras_from_world[v], images_from_world[v],
+                    views[v].intrinsics, views[v].extrinsics, views[v].triangle_ranges);
+        }
+    }
+
+    parallelFor(num_views, [&](size_t v)
+    {
+        auto& view = views[v];
+        drawTriangleRanges(view.pixels, vertices, view.positions_image, triangles, textures, view.triangle_ranges,
+            lightmaps, shadow_map, light.position_world, DEBUG_VIEW_NONE, view.options);
+    });
 }
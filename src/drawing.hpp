@@ -1,14 +1,20 @@
 #pragma once
 
+#include <cstdint>
+
 #include "camera.hpp"
+#include "lightmap.hpp"
 #include "mesh.hpp"
+#include "pvs.hpp"
+#include "quantization.hpp"
 #include "vector_space.hpp"
-#include "sdl_wrappers.hpp"
+#include "shadow_map.hpp"
 #include "texture.hpp"
 
 namespace vertex_index {enum {BARY0, BARY1, BARY2, DISPARITY, U, V, X, Y, Z, SIZE};}
 using Vertex = Eigen::Matrix<double, vertex_index::SIZE, 1>;
-using Pixel = Uint32;
+// ARGB, the same layout as the SDL streaming texture.
+using Pixel = uint32_t;
 
 struct Light
 {
@@ -17,12 +23,24 @@ struct Light
     Vector4d power;
 };
 
+// Diagnostic colors that drawTriangles writes instead of the shaded ones:
+// the depth tests per pixel, the shading cost per pixel, or the triangles
+// that cover each tile.
+enum DebugView : uint8_t
+{
+    DEBUG_VIEW_NONE,
+    DEBUG_VIEW_OVERDRAW,
+    DEBUG_VIEW_SHADER_COST,
+    DEBUG_VIEW_TRIANGLES_PER_TILE,
+};
+
 struct Environment
 {
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     CameraIntrinsics intrinsics;
     CameraExtrinsics extrinsics;
     Light light;
+    DebugView debug_view = DEBUG_VIEW_NONE;
 };
 
 struct Vertices
@@ -34,9 +52,72 @@ struct Vertices
 	Vectors4d positions_world;
 	Vectors4d positions_image;
     Vectors2d positions_texture;
-	size_t size() const { return positions_world.size(); }
+    // Replaces positions_world and positions_texture when not empty.
+    QuantizedAttributes quantized;
+	size_t size() const { return positions_image.size(); }
+    bool isQuantized() const { return !quantized.empty(); }
+    Vector4d positionWorld(size_t i) const
+    {
+        return isQuantized() ? dequantizePosition(quantized, i) : positions_world[i];
+    }
+    Vector2d positionTexture(size_t i) const
+    {
+        return isQuantized() ? dequantizeTexture(quantized, i) : positions_texture[i];
+    }
+};
+
+// Stores the world and texture positions as 16-bit integers and frees the
+// double precision arrays. The image positions are still doubles, so a
+// vertex takes 42 instead of 80 bytes.
+void quantizeVertices(Vertices& vertices);
+
+// Colors or disparities that are either owned or in external memory, like
+// a locked streaming texture or shared memory, so a frame can be rendered
+// where it is presented or read.
+template<typename T>
+class PixelBuffer
+{
+public:
+    explicit PixelBuffer(size_t size) : owned_(size), data_(owned_.data()), size_(size) {}
+    PixelBuffer(const PixelBuffer& other)
+        : owned_(other.owned_)
+        , data_(other.isExternal() ? other.data_ : owned_.data())
+        , size_(other.size_)
+    {}
+    PixelBuffer(PixelBuffer&&) = default;
+    PixelBuffer& operator=(const PixelBuffer& other) { return *this = PixelBuffer(other); }
+    PixelBuffer& operator=(PixelBuffer&&) = default;
+    // Renders into data, which must hold size() values, or into the owned
+    // values if data is nullptr.
+    void setExternal(T* data) { data_ = data ? data : owned_.data(); }
+    // Only reallocates the owned values if they grow beyond their capacity.
+    void resize(size_t size)
+    {
+        const auto external = isExternal();
+        owned_.resize(size);
+        if (!external)
+            data_ = owned_.data();
+        size_ = size;
+    }
+    bool isExternal() const { return data_ != owned_.data(); }
+    size_t size() const { return size_; }
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+    T* begin() { return data_; }
+    T* end() { return data_ + size_; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+    T& operator[](size_t i) { return data_[i]; }
+    const T& operator[](size_t i) const { return data_[i]; }
+private:
+    std::vector<T> owned_;
+    T* data_;
+    size_t size_;
 };
 
+using ColorBuffer = PixelBuffer<Pixel>;
+using DisparityBuffer = PixelBuffer<double>;
+
 struct Pixels
 {
 	Pixels(int width, int height)
@@ -45,17 +126,90 @@ struct Pixels
 		, colors(width * height)
 		, disparities(width * height)
 	{}
-	std::vector<Uint32> colors;
-	std::vector<double> disparities;
+	ColorBuffer colors;
+	DisparityBuffer disparities;
 	size_t width;
 	size_t height;
 	size_t size() const { return width * height; }
+    // Shrinking and growing back is free, since the buffers keep their
+    // capacity.
+    void resize(size_t new_width, size_t new_height)
+    {
+        width = new_width;
+        height = new_height;
+        colors.resize(size());
+        disparities.resize(size());
+    }
+};
+
+struct ShadingRates;
+
+struct DrawOptions
+{
+    // 0 or 1 to only draw the pixels where (x + y) % 2 equals it, or -1 to
+    // draw all pixels.
+    int checkerboard_parity = -1;
+    // Shades blocks of pixels once at coarse rates, if not nullptr and made
+    // for pixels of the same size.
+    ShadingRates* shading_rates = nullptr;
+};
+
+// Triangles [begin, end) of a shape that are drawn by a view.
+struct TriangleRange
+{
+    size_t begin;
+    size_t end;
+};
+
+using TriangleRanges = std::vector<TriangleRange>;
+
+// One camera of drawViews, which draws into its own pixels.
+struct View
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    View(const CameraIntrinsics& intrinsics, const CameraExtrinsics& extrinsics)
+        : intrinsics(intrinsics)
+        , extrinsics(extrinsics)
+        , pixels(int(intrinsics.width), int(intrinsics.height))
+    {}
+    CameraIntrinsics intrinsics;
+    CameraExtrinsics extrinsics;
+    Pixels pixels;
+    // The views are drawn on separate threads, so each view needs its own
+    // shading_rates.
+    DrawOptions options;
+    // Kept between calls to drawViews to reuse their memory.
+    Vectors4d positions_image;
+    TriangleRanges triangle_ranges;
 };
 
+using Views = std::vector<View, Eigen::aligned_allocator<View>>;
+
 void vertexShader(Vertices& vertices, const Environment& environment);
 void drawPoint(Pixels& pixels, const Vector4d& vertex_image);
 void drawPoints(Pixels& pixels, const Vectors4d& vertices_image);
-void drawTriangles(Pixels& pixels, const Vertices& vertices,
-    const Triangles& triangles, const Textures& textures, const Environment& environment);
+// Draws the shapes in the potentially visible set of the camera cell,
+// or all shapes if the sets are empty or the camera is outside the grid.
+// Lighting is looked up in the lightmaps, or computed per pixel if they
+// are empty. Per pixel lighting is shadowed unless the shadow map is empty.
+// Writes the debug view of the environment instead of the shaded colors,
+// if it has one.
+void drawTriangles(Pixels& pixels, const Vertices& vertices, const Triangles& triangles,
+    const Shapes& shapes, const Textures& textures,
+    const PotentiallyVisibleSets& potentially_visible_sets, const Lightmaps& lightmaps,
+    const ShadowMap& shadow_map, const Environment& environment,
+    const DrawOptions& options = DrawOptions{});
+// Draws the same images as vertexShader and drawTriangles with the camera
+// of each view, without a debug view. Each vertex is fetched and each shape
+// is culled in one pass for all views, and then the views are drawn in
+// parallel. Views must not share shading rates.
+void drawViews(Views& views, const Vertices& vertices, const Triangles& triangles,
+    const Shapes& shapes, const Textures& textures,
+    const PotentiallyVisibleSets& potentially_visible_sets, const Lightmaps& lightmaps,
+    const ShadowMap& shadow_map, const Light& light);
 bool isBehindCamera(const Vector4d& v0, const Vector4d& v1, const Vector4d& v2);
+bool isOutsideFrustum(const Vector4d& box_min, const Vector4d& box_max,
+    const Matrix4d& image_from_world, const CameraIntrinsics& intrinsics);
+size_t selectLod(const Shapes& shapes, size_t shape, const Matrix4d& camera_from_world,
+    const CameraExtrinsics& extrinsics, const CameraIntrinsics& intrinsics);
 Light makeLight();
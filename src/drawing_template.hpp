@@ -1,6 +1,8 @@
 #pragma once
 #include <algorithm>
 
+#include "counters.hpp"
+
 template<typename T>
 T min3(T a, T b, T c)
 {
@@ -27,6 +29,9 @@ auto barycentric(
 		 - (vertex_left[1] - vertex_right[1]) * (point[0] - vertex_right[0]);
 }
 
+// Calls the pixel shader for all pixels in the bounding box of the triangle,
+// or only for the pixels where (x + y) % 2 == checkerboard_parity if it is
+// 0 or 1.
 template<typename Vector4, typename Vertex, typename Integer, typename PixelShader>
 void renderTriangleTemplate(
 	const Vector4& v0,
@@ -37,7 +42,8 @@ void renderTriangleTemplate(
     const Vertex& vertex2,
     Integer width,
     Integer height,
-    PixelShader pixel_shader)
+    PixelShader pixel_shader,
+    int checkerboard_parity = -1)
 {
     using Scalar = decltype(v0[0]);
 
@@ -49,8 +55,11 @@ void renderTriangleTemplate(
 	auto y_min = min3(v0[1], v1[1], v2[1]);
 	auto y_max = max3(v0[1], v1[1], v2[1]);
 
-	if (x_max < 0.0 || y_max < 0.0) return;
-	if (width_d - 1.0 < x_min || height_d - 1.0 < y_min) return;
+	if (x_max < 0.0 || y_max < 0.0 || width_d - 1.0 < x_min || height_d - 1.0 < y_min)
+	{
+		COUNT_PIPELINE(triangles_off_screen, 1);
+		return;
+	}
 
 	x_min = clamp(floor(x_min), 0.0, width_d  - 1.0);
 	x_max = clamp( ceil(x_max), 0.0, width_d  - 1.0);
@@ -78,7 +87,14 @@ void renderTriangleTemplate(
 	const auto w1_dy = barycentric(v2, v0, p_down)  - barycentric(v2, v0, p);
 	const auto w2_dy = barycentric(v0, v1, p_down)  - barycentric(v0, v1, p);
 
-	const auto c = 1.0 / barycentric(v0, v1, v2);
+	// Triangles seen edge on cover no pixels and would divide by zero.
+	const auto area = barycentric(v0, v1, v2);
+	if (area == 0.0)
+	{
+		COUNT_PIPELINE(triangles_zero_area, 1);
+		return;
+	}
+	const auto c = 1.0 / area;
 
 	const Vertex vertex_row = c * (w0_row * vertex0 + w1_row * vertex1 + w2_row * vertex2);
 	const Vertex vertex_dx  = c * (w0_dx  * vertex0 + w1_dx  * vertex1 + w2_dx  * vertex2);
@@ -87,6 +103,34 @@ void renderTriangleTemplate(
 	auto index_current_row = y_min_i * width + x_min_i;
 	auto vertex_current_row = vertex_row;
 
+	if (checkerboard_parity >= 0)
+	{
+		const Vertex vertex_2dx = 2 * vertex_dx;
+		for (auto y = y_min_i; y <= y_max_i; ++y)
+		{
+			auto vertex = vertex_current_row;
+			auto index = index_current_row;
+			auto x = x_min_i;
+			if (static_cast<int>((x + y) % 2) != checkerboard_parity)
+			{
+				vertex += vertex_dx;
+				++index;
+				++x;
+			}
+			COUNT_PIPELINE(pixels_tested, x <= x_max_i ? (x_max_i - x) / 2 + 1 : 0);
+			for (; x <= x_max_i; x += 2)
+			{
+				pixel_shader(vertex, index);
+				vertex += vertex_2dx;
+				index += 2;
+			}
+			vertex_current_row += vertex_dy;
+			index_current_row += width;
+		}
+		return;
+	}
+
+	COUNT_PIPELINE(pixels_tested, (x_max_i - x_min_i + 1) * (y_max_i - y_min_i + 1));
 	for (auto y = y_min_i; y <= y_max_i; ++y)
 	{
 		auto vertex = vertex_current_row;
@@ -103,3 +147,29 @@ void renderTriangleTemplate(
 		index_current_row += width;
 	}
 }
+
+// Calls the depth shader with the disparity of each pixel that the triangle
+// covers, for passes that need no other varyings. The coverage is that of
+// the shaders of the other overload, which test that the interpolated
+// barycentric coordinates are non-negative, so the depth and color passes
+// agree at shared edges.
+template<typename Vector4, typename Integer, typename DepthShader>
+void renderTriangleTemplate(
+	const Vector4& v0,
+    const Vector4& v1,
+    const Vector4& v2,
+    Integer width,
+    Integer height,
+    DepthShader depth_shader)
+{
+    const auto covered_shader = [&](const Vector4& vertex, Integer index)
+    {
+        if (vertex[0] < 0.0 || vertex[1] < 0.0 || vertex[2] < 0.0) return;
+        depth_shader(vertex[3], index);
+    };
+    renderTriangleTemplate(v0, v1, v2,
+        Vector4{ 1.0, 0.0, 0.0, v0[2] },
+        Vector4{ 0.0, 1.0, 0.0, v1[2] },
+        Vector4{ 0.0, 0.0, 1.0, v2[2] },
+        width, height, covered_shader);
+}
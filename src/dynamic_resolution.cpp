@@ -0,0 +1,89 @@
+#include "dynamic_resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+
+// Weight of the last frame in the smoothed render time, so a single slow
+// frame does not change the resolution.
+const double TIME_SMOOTHING = 0.2;
+// The scale moves in steps of this, so each size is reused and the
+// streaming texture and other buffers are not reallocated for every frame.
+const double SCALE_STEP = 0.125;
+// The scale goes down when the render time is over the budget, but only
+// goes up if the next step is expected to stay below this fraction of it,
+// so it does not oscillate between two steps.
+const double SCALE_UP_FRACTION = 0.8;
+const size_t MIN_FRAMES_BETWEEN_CHANGES = 30;
+const double REPORT_INTERVAL_SECONDS = 1.0;
+
+} // namespace
+
+DynamicResolution::DynamicResolution(size_t max_width, size_t max_height, double min_scale, double budget_milliseconds)
+    : max_width_(max_width)
+    , max_height_(max_height)
+    , min_scale_(min_scale)
+    , budget_milliseconds_(budget_milliseconds)
+    , scale_(1.0)
+    , width_(max_width)
+    , height_(max_height)
+    , smoothed_milliseconds_(0.0)
+    , num_frames_since_change_(0)
+    , last_report_(std::chrono::steady_clock::now())
+    , num_frames_(0)
+    , total_milliseconds_(0.0)
+{}
+
+void DynamicResolution::update(double frame_milliseconds)
+{
+    using namespace std;
+
+    num_frames_ += 1;
+    total_milliseconds_ += frame_milliseconds;
+
+    smoothed_milliseconds_ = num_frames_since_change_ == 0 ? frame_milliseconds :
+        smoothed_milliseconds_ + TIME_SMOOTHING * (frame_milliseconds - smoothed_milliseconds_);
+    num_frames_since_change_ += 1;
+
+    // The render time is roughly proportional to the number of pixels.
+    const auto expected_milliseconds = [&](double scale)
+    {
+        return smoothed_milliseconds_ * (scale * scale) / (scale_ * scale_);
+    };
+    auto scale = scale_;
+    if (num_frames_since_change_ >= MIN_FRAMES_BETWEEN_CHANGES)
+    {
+        if (smoothed_milliseconds_ > budget_milliseconds_)
+        {
+            // Goes down as many steps as needed at once.
+            do
+                scale = max(scale - SCALE_STEP, min_scale_);
+            while (scale > min_scale_ && expected_milliseconds(scale) > budget_milliseconds_);
+        }
+        else if (scale_ < 1.0 &&
+            expected_milliseconds(min(scale_ + SCALE_STEP, 1.0)) < SCALE_UP_FRACTION * budget_milliseconds_)
+        {
+            scale = min(scale_ + SCALE_STEP, 1.0);
+        }
+    }
+    if (scale != scale_)
+    {
+        scale_ = scale;
+        width_ = max<size_t>(1, static_cast<size_t>(lround(scale_ * max_width_)));
+        height_ = max<size_t>(1, static_cast<size_t>(lround(scale_ * max_height_)));
+        num_frames_since_change_ = 0;
+    }
+
+    const auto now = chrono::steady_clock::now();
+    if (chrono::duration<double>(now - last_report_).count() < REPORT_INTERVAL_SECONDS)
+        return;
+    cout << "Resolution: " << width_ << "x" << height_ << " (" << lround(100 * scale_) << "%)"
+         << ", render time " << total_milliseconds_ / num_frames_ << " ms"
+         << " of " << budget_milliseconds_ << " ms budget" << endl;
+    last_report_ = now;
+    num_frames_ = 0;
+    total_milliseconds_ = 0.0;
+}
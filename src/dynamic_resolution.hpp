@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+// Scales the render resolution between min_scale and 1 of the maximum
+// resolution, to keep the render time of a frame within a budget. The scale
+// changes in a few fixed steps, and at most every 30 frames, so the frame
+// buffers are not reallocated every frame.
+class DynamicResolution
+{
+public:
+    DynamicResolution(size_t max_width, size_t max_height, double min_scale, double budget_milliseconds);
+    size_t width() const { return width_; }
+    size_t height() const { return height_; }
+    // Picks the resolution of the next frame from the render time of the
+    // last one.
+    void update(double frame_milliseconds);
+private:
+    size_t max_width_;
+    size_t max_height_;
+    double min_scale_;
+    double budget_milliseconds_;
+    double scale_;
+    size_t width_;
+    size_t height_;
+    double smoothed_milliseconds_;
+    size_t num_frames_since_change_;
+    std::chrono::steady_clock::time_point last_report_;
+    size_t num_frames_;
+    double total_milliseconds_;
+};
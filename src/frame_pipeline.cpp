@@ -0,0 +1,126 @@
+#include "frame_pipeline.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+
+const double REPORT_INTERVAL_SECONDS = 2.0;
+
+double millisecondsBetween(Clock::time_point start, Clock::time_point stop)
+{
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+} // namespace
+
+FramePipeline::FramePipeline(size_t depth, size_t width, size_t height, RenderFunction render)
+    : render_(std::move(render))
+    , quit_(false)
+{
+    for (size_t i = 0; i < depth; ++i)
+    {
+        frames_.push_back(std::make_unique<Frame>(width, height));
+        free_frames_.push_back(frames_.back().get());
+    }
+    thread_ = std::thread([this]() { run(); });
+}
+
+FramePipeline::~FramePipeline()
+{
+    {
+        auto lock = std::lock_guard<std::mutex>(mutex_);
+        quit_ = true;
+    }
+    condition_.notify_all();
+    thread_.join();
+}
+
+size_t FramePipeline::numInFlight() const
+{
+    auto lock = std::lock_guard<std::mutex>(mutex_);
+    return frames_.size() - free_frames_.size();
+}
+
+void FramePipeline::submit(const Environment& environment)
+{
+    {
+        auto lock = std::unique_lock<std::mutex>(mutex_);
+        condition_.wait(lock, [this]() { return !free_frames_.empty(); });
+        auto frame = free_frames_.front();
+        free_frames_.pop_front();
+        frame->environment = environment;
+        frame->submit_time = Clock::now();
+        queued_frames_.push_back(frame);
+    }
+    condition_.notify_all();
+}
+
+const FramePipeline::Frame& FramePipeline::waitForFrame()
+{
+    auto lock = std::unique_lock<std::mutex>(mutex_);
+    condition_.wait(lock, [this]() { return !done_frames_.empty(); });
+    return *done_frames_.front();
+}
+
+void FramePipeline::releaseFrame()
+{
+    {
+        auto lock = std::lock_guard<std::mutex>(mutex_);
+        free_frames_.push_back(done_frames_.front());
+        done_frames_.pop_front();
+    }
+    condition_.notify_all();
+}
+
+void FramePipeline::run()
+{
+    while (true)
+    {
+        auto frame = static_cast<Frame*>(nullptr);
+        {
+            auto lock = std::unique_lock<std::mutex>(mutex_);
+            condition_.wait(lock, [this]() { return quit_ || !queued_frames_.empty(); });
+            if (quit_)
+                return;
+            frame = queued_frames_.front();
+            queued_frames_.pop_front();
+        }
+        render_(frame->pixels, frame->environment);
+        {
+            auto lock = std::lock_guard<std::mutex>(mutex_);
+            done_frames_.push_back(frame);
+        }
+        condition_.notify_all();
+    }
+}
+
+FrameStatistics::FrameStatistics()
+    : interval_start_(Clock::now())
+    , num_frames_(0)
+    , total_latency_(0.0)
+    , max_latency_(0.0)
+{}
+
+void FrameStatistics::addFrame(Clock::time_point input_time)
+{
+    using namespace std;
+
+    const auto now = Clock::now();
+    const auto latency = millisecondsBetween(input_time, now);
+    num_frames_ += 1;
+    total_latency_ += latency;
+    max_latency_ = max(max_latency_, latency);
+
+    const auto seconds = millisecondsBetween(interval_start_, now) / 1000.0;
+    if (seconds < REPORT_INTERVAL_SECONDS)
+        return;
+    cout << "Frames per second: " << num_frames_ / seconds
+         << ", latency: " << total_latency_ / num_frames_ << " ms average, "
+         << max_latency_ << " ms max" << endl;
+    interval_start_ = now;
+    num_frames_ = 0;
+    total_latency_ = 0.0;
+    max_latency_ = 0.0;
+}
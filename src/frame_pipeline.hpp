@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "drawing.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// Renders frames on a background thread while the calling thread presents
+// earlier ones. At most depth frames are in flight, each with its own
+// pixels, and they are finished in the order they were submitted.
+class FramePipeline
+{
+public:
+    struct Frame
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        Frame(size_t width, size_t height) : pixels(width, height) {}
+        Pixels pixels;
+        Environment environment;
+        Clock::time_point submit_time;
+    };
+    using RenderFunction = std::function<void(Pixels&, const Environment&)>;
+
+    FramePipeline(size_t depth, size_t width, size_t height, RenderFunction render);
+    ~FramePipeline();
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+    size_t depth() const { return frames_.size(); }
+    size_t numInFlight() const;
+    // Queues a frame for rendering. Waits if depth frames are in flight.
+    void submit(const Environment& environment);
+    // Waits for the oldest frame to be rendered. It stays valid until
+    // releaseFrame is called.
+    const Frame& waitForFrame();
+    void releaseFrame();
+private:
+    void run();
+
+    RenderFunction render_;
+    std::vector<std::unique_ptr<Frame>> frames_;
+    std::deque<Frame*> free_frames_;
+    std::deque<Frame*> queued_frames_;
+    std::deque<Frame*> done_frames_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    bool quit_;
+    std::thread thread_;
+};
+
+// Prints the throughput and the latency from input to presentation at a
+// regular interval.
+class FrameStatistics
+{
+public:
+    FrameStatistics();
+    // Call when a frame is presented, with the time its input was read.
+    void addFrame(Clock::time_point input_time);
+private:
+    Clock::time_point interval_start_;
+    size_t num_frames_;
+    double total_latency_;
+    double max_latency_;
+};
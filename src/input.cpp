@@ -85,6 +85,24 @@ Environment handleInput(Environment environment)
         environment.light.position_world(1) -= velocity;
     }
 
+    // Debug views:
+    if (keyboard[SDL_SCANCODE_F1])
+    {
+        environment.debug_view = DEBUG_VIEW_NONE;
+    }
+    if (keyboard[SDL_SCANCODE_F2])
+    {
+        environment.debug_view = DEBUG_VIEW_OVERDRAW;
+    }
+    if (keyboard[SDL_SCANCODE_F3])
+    {
+        environment.debug_view = DEBUG_VIEW_SHADER_COST;
+    }
+    if (keyboard[SDL_SCANCODE_F4])
+    {
+        environment.debug_view = DEBUG_VIEW_TRIANGLES_PER_TILE;
+    }
+
     const auto world_from_camera = worldFromCamera(camera_coordinates);
     const auto velocity_world = Vector4d{ world_from_camera * velocity_camera };
 
@@ -0,0 +1,150 @@
+#include "lightmap.hpp"
+
+#include <chrono>
+#include <iostream>
+
+#include "drawing.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+
+// Distance between lightmap samples in world units.
+const double LIGHTMAP_SAMPLE_DISTANCE = 0.25;
+const size_t MAX_LIGHTMAP_RESOLUTION = 32;
+
+size_t numSamples(size_t resolution)
+{
+    return (resolution + 1) * (resolution + 2) / 2;
+}
+
+} // namespace
+
+Lightmaps bakeLightmaps(const Vertices& vertices, const Triangles& triangles,
+    const Vector4d& light_position_world, const ShadowMap& shadow_map)
+{
+    auto lightmaps = Lightmaps{};
+    lightmaps.light_position_world = light_position_world;
+    lightmaps.offsets.resize(triangles.size());
+    lightmaps.resolutions.resize(triangles.size());
+
+    auto num_samples = size_t{ 0 };
+    for (size_t k = 0; k < triangles.size(); ++k)
+    {
+        const auto p0 = vertices.positionWorld(triangles.indices0[k]);
+        const auto p1 = vertices.positionWorld(triangles.indices1[k]);
+        const auto p2 = vertices.positionWorld(triangles.indices2[k]);
+        const auto longest_edge = std::max({ (p1 - p0).norm(), (p2 - p1).norm(), (p0 - p2).norm() });
+        const auto resolution = std::min(MAX_LIGHTMAP_RESOLUTION,
+            std::max<size_t>(1, static_cast<size_t>(std::ceil(longest_edge / LIGHTMAP_SAMPLE_DISTANCE))));
+        lightmaps.offsets[k] = num_samples;
+        lightmaps.resolutions[k] = static_cast<uint32_t>(resolution);
+        num_samples += numSamples(resolution);
+    }
+    lightmaps.intensities.resize(num_samples);
+
+    parallelFor(triangles.size(), [&](size_t k)
+    {
+        const auto p0 = vertices.positionWorld(triangles.indices0[k]);
+        const auto p1 = vertices.positionWorld(triangles.indices1[k]);
+        const auto p2 = vertices.positionWorld(triangles.indices2[k]);
+        const auto n = lightmaps.resolutions[k];
+        auto sample = lightmaps.offsets[k];
+        for (size_t j = 0; j <= n; ++j)
+        {
+            for (size_t i = 0; i + j <= n; ++i)
+            {
+                const auto s = double(i) / n;
+                const auto t = double(j) / n;
+                const auto position_world = Vector4d{ (1.0 - s - t) * p0 + s * p1 + t * p2 };
+                auto intensity = lightIntensity(position_world, light_position_world);
+                if (!shadow_map.empty())
+                    intensity *= shadow_map.lightFraction(position_world);
+                lightmaps.intensities[sample++] = static_cast<float>(intensity);
+            }
+        }
+    });
+    return lightmaps;
+}
+
+LightmapBaker::LightmapBaker(const Vertices& vertices, const Triangles& triangles, const Shapes& shapes,
+    size_t shadow_map_resolution)
+    : vertices_(vertices)
+    , triangles_(triangles)
+    , shapes_(shapes)
+    , shadow_map_resolution_(shadow_map_resolution)
+    , lightmaps_(std::make_shared<const Lightmaps>())
+    , requested_light_position_(Vector4d::Zero())
+    , has_request_(false)
+    , has_pending_request_(false)
+    , is_baking_(false)
+    , quit_(false)
+    , thread_([this]() { run(); })
+{}
+
+LightmapBaker::~LightmapBaker()
+{
+    {
+        auto lock = std::lock_guard<std::mutex>(mutex_);
+        quit_ = true;
+    }
+    condition_.notify_one();
+    thread_.join();
+}
+
+void LightmapBaker::bake(const Vector4d& light_position_world)
+{
+    {
+        auto lock = std::lock_guard<std::mutex>(mutex_);
+        if (has_request_ && requested_light_position_ == light_position_world)
+            return;
+        requested_light_position_ = light_position_world;
+        has_request_ = true;
+        has_pending_request_ = true;
+    }
+    condition_.notify_one();
+}
+
+std::shared_ptr<const Lightmaps> LightmapBaker::lightmaps() const
+{
+    auto lock = std::lock_guard<std::mutex>(mutex_);
+    return lightmaps_;
+}
+
+std::shared_ptr<const Lightmaps> LightmapBaker::waitForLightmaps() const
+{
+    auto lock = std::unique_lock<std::mutex>(mutex_);
+    baked_.wait(lock, [this]() { return !has_pending_request_ && !is_baking_; });
+    return lightmaps_;
+}
+
+void LightmapBaker::run()
+{
+    using namespace std;
+
+    while (true)
+    {
+        auto light_position_world = Vector4d{};
+        {
+            auto lock = unique_lock<mutex>(mutex_);
+            condition_.wait(lock, [this]() { return quit_ || has_pending_request_; });
+            if (quit_)
+                return;
+            light_position_world = requested_light_position_;
+            has_pending_request_ = false;
+            is_baking_ = true;
+        }
+        const auto start = chrono::steady_clock::now();
+        const auto shadow_map = shadow_map_resolution_ == 0 ? ShadowMap{} :
+            renderShadowMap(vertices_, triangles_, shapes_, light_position_world, shadow_map_resolution_);
+        auto lightmaps = make_shared<const Lightmaps>(bakeLightmaps(vertices_, triangles_, light_position_world, shadow_map));
+        const auto milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "Baked lightmaps with " << lightmaps->intensities.size() << " samples in " << milliseconds << " ms" << endl;
+        {
+            auto lock = lock_guard<mutex>(mutex_);
+            lightmaps_ = move(lightmaps);
+            is_baking_ = false;
+        }
+        baked_.notify_all();
+    }
+}
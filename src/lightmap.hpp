@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mesh.hpp"
+#include "shadow_map.hpp"
+#include "vector_space.hpp"
+
+struct Vertices;
+
+// Light reaching a point from a point light, as used by the pixel shaders.
+inline double lightIntensity(const Vector4d& position_world, const Vector4d& light_position_world)
+{
+    return 16.0 / (position_world - light_position_world).squaredNorm();
+}
+
+// Precomputed light intensities for a static light. Each triangle has a
+// grid of samples over its barycentric coordinates (s, t) of vertex 1 and
+// 2, at s = i / n and t = j / n for i + j <= n. The resolution n depends on
+// the size of the triangle. Row j of triangle k starts at
+// offsets[k] + j * (n + 1) - j * (j - 1) / 2.
+struct Lightmaps
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Vector4d light_position_world;
+    std::vector<size_t> offsets;
+    std::vector<uint32_t> resolutions;
+    std::vector<float> intensities;
+    bool empty() const { return offsets.empty(); }
+
+    float sample(size_t triangle, double s, double t) const
+    {
+        const auto n = static_cast<int>(resolutions[triangle]);
+        const auto j = std::min(std::max(static_cast<int>(std::lround(t * n)), 0), n);
+        const auto i = std::min(std::max(static_cast<int>(std::lround(s * n)), 0), n - j);
+        return intensities[offsets[triangle] + j * (n + 1) - j * (j - 1) / 2 + i];
+    }
+};
+
+// Bakes the lightmaps of all triangles, including all levels of detail.
+// Shadows are baked in unless the shadow map is empty.
+Lightmaps bakeLightmaps(const Vertices& vertices, const Triangles& triangles,
+    const Vector4d& light_position_world, const ShadowMap& shadow_map);
+
+// Rebakes lightmaps on a background thread when the light moves. Drawing
+// continues with the previous lightmaps until the new ones are done. The
+// baker renders its own shadow map unless shadow_map_resolution is 0. The
+// mesh must outlive the baker and its world positions must not change.
+class LightmapBaker
+{
+public:
+    LightmapBaker(const Vertices& vertices, const Triangles& triangles, const Shapes& shapes,
+        size_t shadow_map_resolution);
+    ~LightmapBaker();
+    LightmapBaker(const LightmapBaker&) = delete;
+    LightmapBaker& operator=(const LightmapBaker&) = delete;
+    // Starts a new bake unless the light is where it was last requested.
+    void bake(const Vector4d& light_position_world);
+    // The latest finished lightmaps, which are empty before the first bake.
+    std::shared_ptr<const Lightmaps> lightmaps() const;
+    // Waits until the last requested bake is finished and returns its
+    // lightmaps, for frames that must not depend on timing.
+    std::shared_ptr<const Lightmaps> waitForLightmaps() const;
+private:
+    void run();
+
+    const Vertices& vertices_;
+    const Triangles& triangles_;
+    const Shapes& shapes_;
+    size_t shadow_map_resolution_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    mutable std::condition_variable baked_;
+    std::shared_ptr<const Lightmaps> lightmaps_;
+    Vector4d requested_light_position_;
+    bool has_request_;
+    bool has_pending_request_;
+    bool is_baking_;
+    bool quit_;
+    std::thread thread_;
+};
@@ -1,11 +1,21 @@
 #define SDL_MAIN_HANDLED
 
+#include <iostream>
+
 #include "algorithm.hpp"
 #include "camera.hpp"
+#include "checkerboard.hpp"
 #include "drawing.hpp"
+#include "dynamic_resolution.hpp"
+#include "frame_pipeline.hpp"
 #include "input.hpp"
+#include "lightmap.hpp"
 #include "mesh.hpp"
+#include "pvs.hpp"
+#include "recording.hpp"
 #include "sdl_wrappers.hpp"
+#include "shading_rate.hpp"
+#include "shadow_map.hpp"
 #include "texture.hpp"
 #include "vector_space.hpp"
 
@@ -16,31 +26,207 @@ int main(int, char**)
     const auto height = 600;// 360;
     //const auto filepath = "../../../models/kapell_2017.obj";
     const auto filepath = "../../../models/sibenik/sibenik.obj";
+    // Stores the world and texture positions as 16-bit integers after
+    // loading, which takes a vertex from 80 to 42 bytes, since the image
+    // positions stay in double precision. The model is still loaded in
+    // double precision, so the peak memory does not change. Lossy.
+    const auto quantize_vertices = false;
+    // Bakes the light into lightmaps, which are rebaked when the light moves.
+    const auto use_lightmaps = true;
+    // Resolution of each face of the shadow map cube, or 0 for no shadows.
+    const auto shadow_map_resolution = 512;
+    // Number of frames that are rendered or presented at the same time. With
+    // 1 every frame is rendered straight into the streaming texture, and
+    // with 2 or 3 the next frames are rendered while the last one waits for
+    // vsync, at the cost of latency.
+    const auto pipeline_depth = 2;
+    // Render time budget in milliseconds, which the render resolution is
+    // scaled down to meet, or 0 to always render at full resolution.
+    const auto frame_budget_milliseconds = 16.0;
+    const auto min_resolution_scale = 0.5;
+    // Draws half of the pixels each frame in a checkerboard pattern and
+    // reconstructs the other half from the previous frame.
+    const auto checkerboard_rendering = false;
+    // Shades tiles that were smooth in the last frame once per 1x2, 2x2 or
+    // 4x4 pixels if the estimated error is at most this many 8-bit levels,
+    // or 0 to shade every pixel. Untextured materials are shaded at 2x2.
+    const auto shading_rate_max_error = 0.0;
+    // Writes the environment of every frame to this file on exit, to replay
+    // it later, or empty to not record.
+    const auto record_filepath = "";
+    // Plays back the frames of this recording instead of reading the input,
+    // and exits after the last one, or empty to read the input. Each frame
+    // is rendered at its recorded resolution and waits for the lightmaps of
+    // its light, so with the same settings the frames are the same as
+    // recorded.
+    const auto replay_filepath = "";
 
     auto positions_world = Vectors4d{};
     auto positions_texture = Vectors2d{};
     auto triangles = Triangles{};
+    auto shapes = Shapes{};
     auto textures = Textures{};
-    loadModel(filepath, positions_world, positions_texture, triangles, textures);
+    loadModel(filepath, positions_world, positions_texture, triangles, shapes, textures);
+    auto potentially_visible_sets = PotentiallyVisibleSets{};
+    const auto pvs_filepath = stripFileExtension(filepath) + ".pvs";
+    if (loadPotentiallyVisibleSets(pvs_filepath, hashMesh(positions_world, triangles, shapes), potentially_visible_sets))
+        std::cout << "Loaded potentially visible sets " << pvs_filepath << std::endl;
 	const auto num_vertices = positions_world.size();
 	auto vertices = Vertices(num_vertices);
 	vertices.positions_world = positions_world;
     vertices.positions_texture = positions_texture;
+    if (quantize_vertices)
+    {
+        quantizeVertices(vertices);
+        Vectors4d{}.swap(positions_world);
+        Vectors2d{}.swap(positions_texture);
+        const auto image_size = num_vertices * sizeof(Vector4d);
+        std::cout << "Quantized vertices: " << (image_size + num_vertices * (sizeof(Vector4d) + sizeof(Vector2d))) / 1024
+                  << " KB -> " << (image_size + (vertices.quantized.positions.size() + vertices.quantized.texcoords.size()) * sizeof(uint16_t)) / 1024 << " KB" << std::endl;
+    }
+
+    auto replay = Environments{};
+    if (*replay_filepath)
+    {
+        if (!loadRecording(replay_filepath, replay))
+        {
+            std::cout << "Could not read recording " << replay_filepath << std::endl;
+            return 1;
+        }
+        std::cout << "Replaying " << replay.size() << " frames of " << replay_filepath << std::endl;
+    }
 
     const auto light = makeLight();
     const auto intrinsics = makeCameraIntrinsics(width, height);
     auto extrinsics = CameraExtrinsics{};
-	auto buffers = Pixels(width, height);
 	auto sdl = Sdl(window_title, width, height);
     auto environment = Environment{ intrinsics, extrinsics, light };
+    auto lightmap_baker = LightmapBaker(vertices, triangles, shapes, shadow_map_resolution);
+    auto shadow_map = ShadowMap{};
+    auto statistics = FrameStatistics{};
+    auto resolution = DynamicResolution(width, height, min_resolution_scale, frame_budget_milliseconds);
+    auto checkerboard = CheckerboardReconstruction{};
+    auto shading_rates = ShadingRates{};
+    shading_rates.materials = makeMaterialShadingRates(textures);
+
+    auto recording = Environments{};
+    auto replay_frame = size_t{0};
+    // Reads the input or the replay into the environment of the next frame.
+    // Returns false after the last frame of the replay.
+    const auto next_environment = [&]()
+    {
+        if (replay.empty())
+        {
+            environment = handleInput(environment);
+        }
+        else
+        {
+            if (replay_frame == replay.size())
+                return false;
+            environment = replay[replay_frame++];
+            if (environment.intrinsics.width == 0)
+                environment.intrinsics = intrinsics;
+        }
+        return true;
+    };
+    // The render resolution of a frame, which is the recorded one when
+    // replaying, so the replay does not depend on render times.
+    const auto frame_intrinsics = [&](const Environment& full_resolution_environment)
+    {
+        return replay.empty() ? makeCameraIntrinsics(resolution.width(), resolution.height())
+                              : full_resolution_environment.intrinsics;
+    };
+    const auto save_recording = [&]()
+    {
+        if (!*record_filepath)
+            return;
+        if (saveRecording(record_filepath, recording))
+            std::cout << "Recorded " << recording.size() << " frames to " << record_filepath << std::endl;
+        else
+            std::cout << "Could not write recording " << record_filepath << std::endl;
+    };
+
+    // Only called from one thread at a time.
+    const auto render = [&](Pixels& pixels, const Environment& full_resolution_environment)
+    {
+        const auto start = Clock::now();
+        auto frame_environment = full_resolution_environment;
+        frame_environment.intrinsics = frame_intrinsics(full_resolution_environment);
+        pixels.resize(frame_environment.intrinsics.width, frame_environment.intrinsics.height);
+
+		vertexShader(vertices, frame_environment);
+        if (use_lightmaps)
+            lightmap_baker.bake(frame_environment.light.position_world);
+        const auto lightmaps = replay.empty() ? lightmap_baker.lightmaps() : lightmap_baker.waitForLightmaps();
+        // Shadows are baked into the lightmaps, but the shadow map is also
+        // needed for per pixel lighting before the first bake is done.
+        const auto light_moved = shadow_map.empty() ||
+            shadow_map.light_position_world != frame_environment.light.position_world;
+        if (shadow_map_resolution > 0 && lightmaps->empty() && light_moved)
+            shadow_map = renderShadowMap(vertices, triangles, shapes, frame_environment.light.position_world, shadow_map_resolution);
+        // Debug views draw all pixels and keep them out of the checkerboard
+        // history, the shading rates and the frame budget.
+        const auto is_debug_view = frame_environment.debug_view != DEBUG_VIEW_NONE;
+        auto options = DrawOptions{};
+        if (checkerboard_rendering && !is_debug_view)
+            options.checkerboard_parity = checkerboard.parity();
+        if (shading_rate_max_error > 0.0)
+            options.shading_rates = &shading_rates;
+		drawTriangles(pixels, vertices, triangles, shapes, textures, potentially_visible_sets, *lightmaps, shadow_map, frame_environment, options);
+        if (checkerboard_rendering && !is_debug_view)
+            checkerboard.reconstruct(pixels, frame_environment);
+        if (shading_rate_max_error > 0.0 && !is_debug_view)
+            selectShadingRates(shading_rates, pixels, shading_rate_max_error);
+
+        if (frame_budget_milliseconds > 0.0 && !is_debug_view)
+            resolution.update(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        // Recorded here, since the pipeline picks the resolution when the
+        // frame is rendered.
+        if (*record_filepath)
+            recording.push_back(frame_environment);
+    };
+
+    if (pipeline_depth <= 1)
+    {
+        auto buffers = Pixels(width, height);
+        while (noQuitMessage() && next_environment())
+        {
+            const auto input_time = Clock::now();
+            // Renders straight into the streaming texture when it can be locked.
+            const auto locked_intrinsics = frame_intrinsics(environment);
+            const auto locked_pixels = sdl.lockPixels(locked_intrinsics.width, locked_intrinsics.height);
+            buffers.colors.setExternal(locked_pixels);
+            render(buffers, environment);
+            if (locked_pixels)
+            {
+                sdl.presentLockedPixels();
+            }
+            else
+            {
+                sdl.update(buffers.colors.data(), buffers.width, buffers.height);
+            }
+            statistics.addFrame(input_time);
+        }
+        save_recording();
+        return 0;
+    }
 
-    while (noQuitMessage())
-    {    
-        environment = handleInput(environment);
-		vertexShader(vertices, environment);
-		drawTriangles(buffers, vertices, triangles, textures, environment);
-		sdl.setPixels(buffers.colors.data());
-        sdl.update();
+    // SDL has to be used from the main thread, so it reads input and
+    // presents frames while the pipeline renders the next ones.
+    {
+        auto pipeline = FramePipeline(pipeline_depth, width, height, render);
+        while (noQuitMessage() && next_environment())
+        {
+            pipeline.submit(environment);
+            if (pipeline.numInFlight() < pipeline.depth())
+                continue;
+            const auto& frame = pipeline.waitForFrame();
+            sdl.update(frame.pixels.colors.data(), frame.pixels.width, frame.pixels.height);
+            statistics.addFrame(frame.submit_time);
+            pipeline.releaseFrame();
+        }
     }
+    // The render thread is joined, so it no longer adds to the recording.
+    save_recording();
     return 0;
 }
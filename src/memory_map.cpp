@@ -0,0 +1,72 @@
+#include "memory_map.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MemoryMap::MemoryMap(const std::string& filepath)
+    : data_(nullptr)
+    , size_(0)
+    , file_(INVALID_HANDLE_VALUE)
+    , mapping_(nullptr)
+{
+    file_ = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE)
+        return;
+    auto size = LARGE_INTEGER{};
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+        return;
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_)
+        return;
+    data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (data_)
+        size_ = static_cast<size_t>(size.QuadPart);
+}
+
+MemoryMap::~MemoryMap()
+{
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+}
+
+#else
+
+MemoryMap::MemoryMap(const std::string& filepath)
+    : data_(nullptr)
+    , size_(0)
+{
+    const auto file = open(filepath.c_str(), O_RDONLY);
+    if (file < 0)
+        return;
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size > 0)
+    {
+        const auto size = static_cast<size_t>(status.st_size);
+        const auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data != MAP_FAILED)
+        {
+            data_ = static_cast<const char*>(data);
+            size_ = size;
+        }
+    }
+    // The mapping stays valid after the descriptor is closed.
+    close(file);
+}
+
+MemoryMap::~MemoryMap()
+{
+    if (data_) munmap(const_cast<char*>(data_), size_);
+}
+
+#endif
@@ -1,9 +1,18 @@
 #include "mesh.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <limits>
 #include <random>
+#include <unordered_map>
 
+#include "drawing.hpp"
+#include "mesh_cache.hpp"
+#include "obj_parser.hpp"
+#include "simplification.hpp"
 #include "tiny_obj_loader.h"
 
 Vectors4d makeSphere(int num_points)
@@ -29,6 +38,11 @@ Vectors4d makeSphere(int num_points)
     return vertices_world;
 }
 
+const auto WELD_POSITION_EPSILON = 1e-5;
+const auto WELD_TEXTURE_EPSILON = 1e-5;
+const auto MAX_CLUSTER_TRIANGLES = 1024;
+const auto MAX_LODS = 5;
+
 std::string getDirectoryPath(const std::string filepath)
 {
     return filepath.substr(0, filepath.find_last_of("/\\") + 1);
@@ -39,15 +53,267 @@ std::string stripFileExtension(const std::string filepath)
     return filepath.substr(0, filepath.find_last_of("."));
 }
 
-void loadModel(
+Textures readTextures(const std::vector<std::string>& filenames, const std::string& dirpath)
+{
+    auto textures = Textures(filenames.size());
+    for (size_t i = 0; i < textures.size(); ++i)
+    {
+        const auto filename_png = filenames[i];
+        if (filename_png.empty())
+            continue;
+        const auto filename = stripFileExtension(filename_png);
+        const auto filename_ppm = filename + ".ppm";
+        const auto filepath_ppm = dirpath + filename_ppm;
+        textures[i] = readTexture(filepath_ppm);
+    }
+    return textures;
+}
+
+void computeBoundingBoxes(const Vectors4d& positions_world, const Triangles& triangles, Shapes& shapes)
+{
+    const auto num_shapes = shapes.size();
+    shapes.bounding_box_mins = Vectors4d(num_shapes);
+    shapes.bounding_box_maxs = Vectors4d(num_shapes);
+
+    for (size_t s = 0; s < num_shapes; ++s)
+    {
+        const auto infinity = std::numeric_limits<double>::infinity();
+        auto box_min = Vector4d{ +infinity, +infinity, +infinity, 1.0 };
+        auto box_max = Vector4d{ -infinity, -infinity, -infinity, 1.0 };
+        for (size_t i = shapes.triangle_begins[s]; i < shapes.triangle_ends[s]; ++i)
+        {
+            for (const auto index : { triangles.indices0[i], triangles.indices1[i], triangles.indices2[i] })
+            {
+                box_min = box_min.cwiseMin(positions_world[index]);
+                box_max = box_max.cwiseMax(positions_world[index]);
+            }
+        }
+        shapes.bounding_box_mins[s] = box_min;
+        shapes.bounding_box_maxs[s] = box_max;
+    }
+}
+
+namespace
+{
+
+void splitCluster(const Vectors4d& centroids, std::vector<size_t>& order,
+    size_t begin, size_t end, size_t max_triangles, Shapes& clusters)
+{
+    if (end - begin <= max_triangles)
+    {
+        clusters.triangle_begins.push_back(begin);
+        clusters.triangle_ends.push_back(end);
+        return;
+    }
+    const auto infinity = std::numeric_limits<double>::infinity();
+    auto box_min = Vector4d{ +infinity, +infinity, +infinity, 0.0 };
+    auto box_max = Vector4d{ -infinity, -infinity, -infinity, 0.0 };
+    for (auto i = begin; i < end; ++i)
+    {
+        box_min = box_min.cwiseMin(centroids[order[i]]);
+        box_max = box_max.cwiseMax(centroids[order[i]]);
+    }
+    auto axis = Eigen::Index{};
+    (box_max - box_min).maxCoeff(&axis);
+    const auto middle = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+        [&](size_t a, size_t b) { return centroids[a](axis) < centroids[b](axis); });
+    splitCluster(centroids, order, begin, middle, max_triangles, clusters);
+    splitCluster(centroids, order, middle, end, max_triangles, clusters);
+}
+
+template<typename Container>
+void permute(Container& container, const std::vector<size_t>& order)
+{
+    auto permuted = Container(container.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        permuted[i] = container[order[i]];
+    container.swap(permuted);
+}
+
+} // namespace
+
+void splitIntoClusters(const Vectors4d& positions_world, Triangles& triangles, Shapes& shapes,
+    size_t max_triangles)
+{
+    auto centroids = Vectors4d(triangles.size());
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        centroids[i] = (positions_world[triangles.indices0[i]] +
+                        positions_world[triangles.indices1[i]] +
+                        positions_world[triangles.indices2[i]]) / 3.0;
+    }
+    auto order = std::vector<size_t>(triangles.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+
+    auto clusters = Shapes{};
+    for (size_t s = 0; s < shapes.size(); ++s)
+    {
+        splitCluster(centroids, order, shapes.triangle_begins[s], shapes.triangle_ends[s],
+            max_triangles, clusters);
+    }
+    permute(triangles.indices0, order);
+    permute(triangles.indices1, order);
+    permute(triangles.indices2, order);
+    permute(triangles.texture_indices, order);
+    computeBoundingBoxes(positions_world, triangles, clusters);
+    shapes = clusters;
+}
+
+namespace
+{
+
+struct WeldKey
+{
+    int64_t x, y, z, u, v;
+    bool operator==(const WeldKey& other) const
+    {
+        return x == other.x && y == other.y && z == other.z && u == other.u && v == other.v;
+    }
+};
+
+struct WeldKeyHash
+{
+    size_t operator()(const WeldKey& key) const
+    {
+        auto hash = uint64_t{14695981039346656037ull};
+        for (const auto value : { key.x, key.y, key.z, key.u, key.v })
+            hash = (hash ^ static_cast<uint64_t>(value)) * 1099511628211ull;
+        return static_cast<size_t>(hash);
+    }
+};
+
+} // namespace
+
+size_t weldVertices(
+    Vectors4d& positions_world,
+    Vectors2d& positions_texture,
+    Triangles& triangles,
+    double position_epsilon,
+    double texture_epsilon)
+{
+    // The cells are many epsilons large, so the vertices within epsilon of a
+    // vertex are in its cell, or in the neighbouring cells along the
+    // coordinates that are near a cell border, which is rare. Near is within
+    // two epsilons, so rounding cannot hide a neighbour. The cells are
+    // centered on round numbers, which many models are built from.
+    const auto cell_size = 16.0;
+    const auto num_coordinates = 5;
+    const auto cellAndSide = [&](double value, double epsilon, int64_t& cell, int64_t& side)
+    {
+        const auto scaled = value / (cell_size * epsilon) + 0.5;
+        const auto cell_floor = std::floor(scaled);
+        cell = static_cast<int64_t>(cell_floor);
+        const auto fraction = scaled - cell_floor;
+        side = fraction * cell_size < 2.0 ? -1 : (1.0 - fraction) * cell_size < 2.0 ? 1 : 0;
+    };
+    const auto isClose = [&](size_t a, size_t b)
+    {
+        const auto& pa = positions_world[a];
+        const auto& pb = positions_world[b];
+        const auto& ta = positions_texture[a];
+        const auto& tb = positions_texture[b];
+        return std::abs(pa(0) - pb(0)) <= position_epsilon
+            && std::abs(pa(1) - pb(1)) <= position_epsilon
+            && std::abs(pa(2) - pb(2)) <= position_epsilon
+            && std::abs(ta(0) - tb(0)) <= texture_epsilon
+            && std::abs(ta(1) - tb(1)) <= texture_epsilon;
+    };
+
+    // The last welded vertex of each cell, and the welded vertex before each
+    // welded vertex in its cell.
+    const auto not_welded = std::numeric_limits<size_t>::max();
+    auto last_in_cells = std::unordered_map<WeldKey, size_t, WeldKeyHash>{};
+    last_in_cells.reserve(positions_world.size());
+    auto previous_in_cell = std::vector<size_t>{};
+    previous_in_cell.reserve(positions_world.size());
+    auto old_from_new = std::vector<size_t>{};
+    old_from_new.reserve(positions_world.size());
+    auto new_from_old = std::vector<size_t>(positions_world.size(), not_welded);
+
+    // Number the welded vertices in the order the triangles first use them,
+    // so that the vertices of nearby triangles are close in memory. A vertex
+    // is merged into the first welded vertex within the epsilons.
+    const auto weld = [&](size_t& index)
+    {
+        if (new_from_old[index] != not_welded)
+        {
+            index = new_from_old[index];
+            return;
+        }
+        const auto& p = positions_world[index];
+        const auto& t = positions_texture[index];
+        int64_t cell[num_coordinates], side[num_coordinates];
+        cellAndSide(p(0), position_epsilon, cell[0], side[0]);
+        cellAndSide(p(1), position_epsilon, cell[1], side[1]);
+        cellAndSide(p(2), position_epsilon, cell[2], side[2]);
+        cellAndSide(t(0), texture_epsilon, cell[3], side[3]);
+        cellAndSide(t(1), texture_epsilon, cell[4], side[4]);
+        auto welded = not_welded;
+        for (int neighbour = 0; neighbour < 1 << num_coordinates; ++neighbour)
+        {
+            auto key = WeldKey{ cell[0], cell[1], cell[2], cell[3], cell[4] };
+            auto is_searched = true;
+            int64_t* coordinates[num_coordinates] = { &key.x, &key.y, &key.z, &key.u, &key.v };
+            for (int c = 0; c < num_coordinates; ++c)
+            {
+                if ((neighbour >> c & 1) == 0) continue;
+                is_searched = is_searched && side[c] != 0;
+                *coordinates[c] += side[c];
+            }
+            if (!is_searched) continue;
+            const auto found = last_in_cells.find(key);
+            if (found == last_in_cells.end()) continue;
+            for (auto candidate = found->second; candidate != not_welded; candidate = previous_in_cell[candidate])
+            {
+                if (candidate < welded && isClose(index, old_from_new[candidate]))
+                    welded = candidate;
+            }
+        }
+        if (welded == not_welded)
+        {
+            welded = old_from_new.size();
+            old_from_new.push_back(index);
+            auto& last_in_cell = last_in_cells.emplace(
+                WeldKey{ cell[0], cell[1], cell[2], cell[3], cell[4] }, not_welded).first->second;
+            previous_in_cell.push_back(last_in_cell);
+            last_in_cell = welded;
+        }
+        new_from_old[index] = welded;
+        index = welded;
+    };
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        weld(triangles.indices0[i]);
+        weld(triangles.indices1[i]);
+        weld(triangles.indices2[i]);
+    }
+
+    auto welded_positions_world = Vectors4d(old_from_new.size());
+    auto welded_positions_texture = Vectors2d(old_from_new.size());
+    for (size_t i = 0; i < old_from_new.size(); ++i)
+    {
+        welded_positions_world[i] = positions_world[old_from_new[i]];
+        welded_positions_texture[i] = positions_texture[old_from_new[i]];
+    }
+    const auto num_removed = positions_world.size() - old_from_new.size();
+    positions_world.swap(welded_positions_world);
+    positions_texture.swap(welded_positions_texture);
+    return num_removed;
+}
+
+void loadObj(
     const std::string& filepath,
     Vectors4d& positions_world,
     Vectors2d& positions_texture,
     Triangles& triangles,
+    Shapes& shapes,
     Textures& textures)
 {
     using namespace std;
-    vector<tinyobj::shape_t> shapes;
+    vector<tinyobj::shape_t> obj_shapes;
     vector<tinyobj::material_t> materials;
     string error_message;
 
@@ -55,58 +321,136 @@ void loadModel(
 
     const auto dirpath = getDirectoryPath(filepath);
 
-    if (!tinyobj::LoadObj(shapes, materials, error_message, filepath.c_str(), dirpath.c_str()))
+    if (!tinyobj::LoadObj(obj_shapes, materials, error_message, filepath.c_str(), dirpath.c_str()))
         cerr << error_message << endl;
 
-    cout << "# of shapes    : " << shapes.size() << endl;
+    cout << "# of shapes    : " << obj_shapes.size() << endl;
     cout << "# of materials : " << materials.size() << endl;
 
-    const auto& mesh = shapes.front().mesh;
-    assert(mesh.positions.size() % 3 == 0);
-    assert(mesh.texcoords.size() % 2 == 0);
-    assert(mesh.positions.size() / 3 == mesh.texcoords.size() / 2);
-
-    const auto num_positions = mesh.positions.size() / 3;
+    // Faces without a material use the empty texture after the materials.
+    const auto no_material = materials.size();
 
-    positions_world   = Vectors4d(num_positions);
-    positions_texture = Vectors2d(num_positions);
+    positions_world.clear();
+    positions_texture.clear();
 
-    for (size_t i = 0; i < num_positions; ++i)
+    for (const auto& obj_shape : obj_shapes)
     {
-        auto x = double{ mesh.positions[3 * i + 0] };
-        auto y = double{ mesh.positions[3 * i + 1] };
-        auto z = double{ mesh.positions[3 * i + 2] };
-        auto w = 1.0;
-        positions_world[i] = Vector4d{ x, y, z, w };
+        const auto& mesh = obj_shape.mesh;
+        assert(mesh.positions.size() % 3 == 0);
+        assert(mesh.texcoords.size() % 2 == 0);
+
+        const auto num_positions = mesh.positions.size() / 3;
+        const auto num_texcoords = mesh.texcoords.size() / 2;
+        const auto first_position = positions_world.size();
+
+        for (size_t i = 0; i < num_positions; ++i)
+        {
+            auto x = double{ mesh.positions[3 * i + 0] };
+            auto y = double{ mesh.positions[3 * i + 1] };
+            auto z = double{ mesh.positions[3 * i + 2] };
+            auto w = 1.0;
+            positions_world.push_back(Vector4d{ x, y, z, w });
+        }
+
+        // Shapes without texture coordinates get zeros.
+        for (size_t i = 0; i < num_positions; ++i)
+        {
+            auto x = i < num_texcoords ? double{ mesh.texcoords[2 * i + 0] } : 0.0;
+            auto y = i < num_texcoords ? double{ mesh.texcoords[2 * i + 1] } : 0.0;
+            positions_texture.push_back(Vector2d{ x, y });
+        }
+
+        const auto num_triangles = mesh.indices.size() / 3;
+        shapes.triangle_begins.push_back(triangles.size());
+
+        for (size_t f = 0; f < num_triangles; ++f)
+        {
+            const auto material_id = mesh.material_ids[f];
+            triangles.indices0.push_back(first_position + mesh.indices[3 * f + 0]);
+            triangles.indices1.push_back(first_position + mesh.indices[3 * f + 1]);
+            triangles.indices2.push_back(first_position + mesh.indices[3 * f + 2]);
+            triangles.texture_indices.push_back(material_id < 0 ? no_material : material_id);
+        }
+
+        shapes.triangle_ends.push_back(triangles.size());
     }
 
-    for (size_t i = 0; i < num_positions; ++i)
+    computeBoundingBoxes(positions_world, triangles, shapes);
+
+    auto texture_filenames = vector<string>{};
+    for (const auto& material : materials)
+        texture_filenames.push_back(material.ambient_texname);
+    texture_filenames.push_back("");
+    textures = readTextures(texture_filenames, dirpath);
+}
+
+namespace
+{
+
+// Returns the best time of a few vertexShader calls on the positions.
+double vertexShaderMilliseconds(const Vectors4d& positions_world)
+{
+    using namespace std::chrono;
+    auto vertices = Vertices(positions_world.size());
+    vertices.positions_world = positions_world;
+    const auto environment = Environment{ makeCameraIntrinsics(800, 600), CameraExtrinsics{}, makeLight() };
+    auto best = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < 3; ++i)
     {
-        auto x = double{ mesh.texcoords[2 * i + 0] };
-        auto y = double{ mesh.texcoords[2 * i + 1] };
-        positions_texture[i] = Vector2d{ x, y };
+        const auto start = steady_clock::now();
+        vertexShader(vertices, environment);
+        best = std::min(best, duration<double, std::milli>(steady_clock::now() - start).count());
     }
+    return best;
+}
 
-    const auto num_triangles = mesh.indices.size() / 3;
+} // namespace
+
+void loadModel(
+    const std::string& filepath,
+    Vectors4d& positions_world,
+    Vectors2d& positions_texture,
+    Triangles& triangles,
+    Shapes& shapes,
+    Textures& textures)
+{
+    using namespace std;
+    using namespace std::chrono;
+    const auto start = steady_clock::now();
+    const auto cache_filepath = stripFileExtension(filepath) + ".meshcache";
 
-    for (size_t f = 0; f < num_triangles; ++f)
+    if (loadMeshCache(cache_filepath, filepath, positions_world, positions_texture, triangles, shapes, textures))
     {
-        triangles.indices0.push_back(mesh.indices[3 * f + 0]);
-        triangles.indices1.push_back(mesh.indices[3 * f + 1]);
-        triangles.indices2.push_back(mesh.indices[3 * f + 2]);
-        triangles.texture_indices.push_back(mesh.material_ids[f]);
+        cout << "Loaded mesh cache " << cache_filepath;
     }
-
-    textures = Textures(materials.size());
-    for (size_t i = 0; i < textures.size(); ++i)
+    else
     {
-        const auto filename_png = materials[i].ambient_texname;
-        if (filename_png.empty())
-            continue;
-        const auto filename = stripFileExtension(filename_png);
-        const auto filename_ppm = filename + ".ppm";
-        const auto filepath_ppm = dirpath + filename_ppm;
-        textures[i] = readTexture(filepath_ppm);
+        triangles = Triangles{};
+        shapes = Shapes{};
+        if (!loadObjParallel(filepath, positions_world, positions_texture, triangles, shapes, textures))
+            return;
+
+        splitIntoClusters(positions_world, triangles, shapes, MAX_CLUSTER_TRIANGLES);
+        cout << "# of clusters  : " << shapes.size() << endl;
+
+        const auto num_vertices = positions_world.size();
+        const auto unwelded_milliseconds = vertexShaderMilliseconds(positions_world);
+        const auto num_removed = weldVertices(positions_world, positions_texture, triangles,
+            WELD_POSITION_EPSILON, WELD_TEXTURE_EPSILON);
+        const auto welded_milliseconds = vertexShaderMilliseconds(positions_world);
+        cout << "Welded vertices: " << num_vertices << " -> " << positions_world.size()
+             << " (" << 100.0 * num_removed / max<size_t>(num_vertices, 1) << "% fewer"
+             << ", vertex shader " << unwelded_milliseconds << " -> " << welded_milliseconds
+             << " ms)" << endl;
+
+        const auto num_triangles = triangles.size();
+        makeLods(positions_world, triangles, shapes, MAX_LODS);
+        cout << "LOD triangles  : " << triangles.size() - num_triangles << endl;
+
+        if (saveMeshCache(cache_filepath, filepath, positions_world, positions_texture, triangles, shapes, textures))
+            cout << "Wrote mesh cache " << cache_filepath << endl;
+        cout << "Imported " << filepath;
     }
+    const auto milliseconds = duration_cast<duration<double, milli>>(steady_clock::now() - start).count();
+    cout << " in " << milliseconds << " ms" << endl;
 }
-
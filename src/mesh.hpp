@@ -15,11 +15,64 @@ struct Triangles
 	size_t size() const { return indices0.size(); }
 };
 
+// Draw range and world bounding box of each shape in the OBJ file.
+// The triangles of shape i are [triangle_begins[i], triangle_ends[i]).
+// The levels of detail of shape i are the entries [lod_begins[i], lod_ends[i])
+// of the lod arrays, from the full shape to the coarsest level. A level has
+// its own triangle range and its geometric error in world units.
+struct Shapes
+{
+    std::vector<size_t> triangle_begins;
+    std::vector<size_t> triangle_ends;
+    Vectors4d bounding_box_mins;
+    Vectors4d bounding_box_maxs;
+    std::vector<size_t> lod_begins;
+    std::vector<size_t> lod_ends;
+    std::vector<size_t> lod_triangle_begins;
+    std::vector<size_t> lod_triangle_ends;
+    std::vector<double> lod_errors;
+    size_t size() const { return triangle_begins.size(); }
+};
+
 Vectors4d makeSphere(int num_points);
 
+std::string getDirectoryPath(const std::string filepath);
+std::string stripFileExtension(const std::string filepath);
+Textures readTextures(const std::vector<std::string>& filenames, const std::string& dirpath);
+void computeBoundingBoxes(const Vectors4d& positions_world, const Triangles& triangles, Shapes& shapes);
+
+// Splits each shape into spatially compact shapes of at most max_triangles
+// by recursive median splits of the triangle centroids. Reorders the
+// triangles and recomputes the bounding boxes.
+void splitIntoClusters(const Vectors4d& positions_world, Triangles& triangles, Shapes& shapes,
+    size_t max_triangles);
+
+// Merges each vertex into the first vertex used by the triangles whose
+// position and texture coordinates are all within the epsilons of its own,
+// drops unused vertices and rewrites the triangle indices. Returns the
+// number of removed vertices.
+size_t weldVertices(
+    Vectors4d& positions_world,
+    Vectors2d& positions_texture,
+    Triangles& triangles,
+    double position_epsilon,
+    double texture_epsilon);
+
+// Imports the OBJ file with tinyobj.
+void loadObj(
+    const std::string& filepath,
+    Vectors4d& positions_world,
+    Vectors2d& positions_texture,
+    Triangles& triangles,
+    Shapes& shapes,
+    Textures& textures);
+
+// Loads the mesh cache next to the OBJ file, or imports the OBJ file
+// and writes the cache.
 void loadModel(
     const std::string& filepath,
     Vectors4d& positions_world,
     Vectors2d& positions_texture,
     Triangles& triangles,
+    Shapes& shapes,
     Textures& textures);
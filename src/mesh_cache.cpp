@@ -0,0 +1,266 @@
+#include "mesh_cache.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "memory_map.hpp"
+
+namespace
+{
+
+const char MAGIC[8] = {'R', 'A', 'S', 'T', 'M', 'E', 'S', 'H'};
+const uint32_t VERSION = 4;
+const size_t ALIGNMENT = 64;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t size_of_size_t;
+    uint64_t source_size;
+    int64_t source_time;
+    uint64_t num_positions;
+    uint64_t num_triangles;
+    uint64_t num_shapes;
+    uint64_t num_lods;
+    uint64_t num_textures;
+};
+
+struct TextureHeader
+{
+    uint64_t width;
+    uint64_t height;
+};
+
+size_t alignUp(size_t offset)
+{
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+bool sourceStamp(const std::string& source_filepath, uint64_t& size, int64_t& time)
+{
+    auto error = std::error_code{};
+    size = std::filesystem::file_size(source_filepath, error);
+    if (error) return false;
+    time = std::filesystem::last_write_time(source_filepath, error).time_since_epoch().count();
+    return !error;
+}
+
+class Writer
+{
+public:
+    Writer(const std::string& filepath) : file(filepath, std::ios::binary), offset(0) {}
+    bool good() const { return file.good(); }
+
+    template<typename T>
+    void write(const T* values, size_t count)
+    {
+        pad();
+        file.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+        offset += count * sizeof(T);
+    }
+
+    template<typename Container>
+    void writeArray(const Container& container)
+    {
+        write(container.data(), container.size());
+    }
+private:
+    void pad()
+    {
+        static const char zeros[ALIGNMENT] = {};
+        const auto aligned = alignUp(offset);
+        file.write(zeros, aligned - offset);
+        offset = aligned;
+    }
+    std::ofstream file;
+    size_t offset;
+};
+
+class Reader
+{
+public:
+    Reader(const MemoryMap& memory_map) : memory_map(memory_map), offset(0) {}
+
+    template<typename T>
+    const T* read(size_t count)
+    {
+        offset = alignUp(offset);
+        // Compares counts instead of byte sizes, which a corrupt count
+        // could overflow.
+        if (offset > memory_map.size() || count > (memory_map.size() - offset) / sizeof(T)) return nullptr;
+        const auto result = reinterpret_cast<const T*>(memory_map.data() + offset);
+        offset += count * sizeof(T);
+        return result;
+    }
+private:
+    const MemoryMap& memory_map;
+    size_t offset;
+};
+
+template<typename Container>
+bool readInto(Reader& reader, size_t count, Container& container)
+{
+    using Value = typename Container::value_type;
+    const auto begin = reader.read<Value>(count);
+    if (!begin) return false;
+    container.assign(begin, begin + count);
+    return true;
+}
+
+bool isRange(size_t begin, size_t end, size_t size)
+{
+    return begin <= end && end <= size;
+}
+
+// The indices and ranges must be inside the arrays they refer to.
+bool isValid(size_t num_positions, const Triangles& triangles, const Shapes& shapes, size_t num_textures)
+{
+    for (size_t t = 0; t < triangles.size(); ++t)
+    {
+        if (triangles.indices0[t] >= num_positions || triangles.indices1[t] >= num_positions ||
+            triangles.indices2[t] >= num_positions || triangles.texture_indices[t] >= num_textures)
+            return false;
+    }
+    const auto num_lods = shapes.lod_errors.size();
+    for (size_t s = 0; s < shapes.size(); ++s)
+    {
+        if (!isRange(shapes.triangle_begins[s], shapes.triangle_ends[s], triangles.size()))
+            return false;
+        // Each shape has at least its full level of detail.
+        if (shapes.lod_begins[s] >= shapes.lod_ends[s] || shapes.lod_ends[s] > num_lods)
+            return false;
+    }
+    for (size_t l = 0; l < num_lods; ++l)
+    {
+        if (!isRange(shapes.lod_triangle_begins[l], shapes.lod_triangle_ends[l], triangles.size()))
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool loadMeshCache(
+    const std::string& cache_filepath,
+    const std::string& source_filepath,
+    Vectors4d& positions_world,
+    Vectors2d& positions_texture,
+    Triangles& triangles,
+    Shapes& shapes,
+    Textures& textures)
+{
+    const auto memory_map = MemoryMap(cache_filepath);
+    if (memory_map.empty())
+        return false;
+
+    auto reader = Reader(memory_map);
+    const auto header = reader.read<Header>(1);
+    if (!header) return false;
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0) return false;
+    if (header->version != VERSION) return false;
+    if (header->size_of_size_t != sizeof(size_t)) return false;
+
+    // A missing source file counts as changed, so a stale cache is not used.
+    auto source_size = uint64_t{};
+    auto source_time = int64_t{};
+    if (!sourceStamp(source_filepath, source_size, source_time))
+        return false;
+    if (header->source_size != source_size || header->source_time != source_time)
+        return false;
+
+    const auto num_positions = header->num_positions;
+    const auto num_triangles = header->num_triangles;
+    const auto num_shapes = header->num_shapes;
+    const auto num_lods = header->num_lods;
+
+    if (!readInto(reader, num_positions, positions_world)) return false;
+    if (!readInto(reader, num_positions, positions_texture)) return false;
+    if (!readInto(reader, num_triangles, triangles.indices0)) return false;
+    if (!readInto(reader, num_triangles, triangles.indices1)) return false;
+    if (!readInto(reader, num_triangles, triangles.indices2)) return false;
+    if (!readInto(reader, num_triangles, triangles.texture_indices)) return false;
+    if (!readInto(reader, num_shapes, shapes.triangle_begins)) return false;
+    if (!readInto(reader, num_shapes, shapes.triangle_ends)) return false;
+    if (!readInto(reader, num_shapes, shapes.bounding_box_mins)) return false;
+    if (!readInto(reader, num_shapes, shapes.bounding_box_maxs)) return false;
+    if (!readInto(reader, num_shapes, shapes.lod_begins)) return false;
+    if (!readInto(reader, num_shapes, shapes.lod_ends)) return false;
+    if (!readInto(reader, num_lods, shapes.lod_triangle_begins)) return false;
+    if (!readInto(reader, num_lods, shapes.lod_triangle_ends)) return false;
+    if (!readInto(reader, num_lods, shapes.lod_errors)) return false;
+
+    // Each texture has at least a header left in the file.
+    if (header->num_textures > memory_map.size() / sizeof(TextureHeader)) return false;
+    textures = Textures(header->num_textures);
+    for (auto& texture : textures)
+    {
+        const auto texture_header = reader.read<TextureHeader>(1);
+        if (!texture_header) return false;
+        const auto width = texture_header->width;
+        const auto height = texture_header->height;
+        if (width != 0 && height > SIZE_MAX / width) return false;
+        const auto colors = reader.read<Vector4d>(width * height);
+        if (!colors) return false;
+        texture = Texture(width, height);
+        for (size_t i = 0; i < texture.size(); ++i)
+            texture[i] = colors[i];
+    }
+    return isValid(num_positions, triangles, shapes, textures.size());
+}
+
+bool saveMeshCache(
+    const std::string& cache_filepath,
+    const std::string& source_filepath,
+    const Vectors4d& positions_world,
+    const Vectors2d& positions_texture,
+    const Triangles& triangles,
+    const Shapes& shapes,
+    const Textures& textures)
+{
+    auto header = Header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.size_of_size_t = sizeof(size_t);
+    if (!sourceStamp(source_filepath, header.source_size, header.source_time))
+        return false;
+    header.num_positions = positions_world.size();
+    header.num_triangles = triangles.size();
+    header.num_shapes = shapes.size();
+    header.num_lods = shapes.lod_errors.size();
+    header.num_textures = textures.size();
+
+    auto writer = Writer(cache_filepath);
+    writer.write(&header, 1);
+    writer.writeArray(positions_world);
+    writer.writeArray(positions_texture);
+    writer.writeArray(triangles.indices0);
+    writer.writeArray(triangles.indices1);
+    writer.writeArray(triangles.indices2);
+    writer.writeArray(triangles.texture_indices);
+    writer.writeArray(shapes.triangle_begins);
+    writer.writeArray(shapes.triangle_ends);
+    writer.writeArray(shapes.bounding_box_mins);
+    writer.writeArray(shapes.bounding_box_maxs);
+    writer.writeArray(shapes.lod_begins);
+    writer.writeArray(shapes.lod_ends);
+    writer.writeArray(shapes.lod_triangle_begins);
+    writer.writeArray(shapes.lod_triangle_ends);
+    writer.writeArray(shapes.lod_errors);
+
+    for (const auto& texture : textures)
+    {
+        const auto texture_header = TextureHeader{ texture.width(), texture.height() };
+        writer.write(&texture_header, 1);
+        writer.writeArray(texture.colors());
+    }
+    if (!writer.good())
+    {
+        std::cerr << "Failed to write mesh cache " << cache_filepath << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+#include "mesh.hpp"
+#include "texture.hpp"
+#include "vector_space.hpp"
+
+// Binary cache of an imported model. The arrays are stored in the same
+// memory layout as the renderer uses, so loading is a bulk copy out of a
+// memory mapped file instead of parsing text.
+// The cache is rejected if the version or the source file has changed, if
+// the source file is missing, or if an index is out of range.
+
+bool loadMeshCache(
+    const std::string& cache_filepath,
+    const std::string& source_filepath,
+    Vectors4d& positions_world,
+    Vectors2d& positions_texture,
+    Triangles& triangles,
+    Shapes& shapes,
+    Textures& textures);
+
+bool saveMeshCache(
+    const std::string& cache_filepath,
+    const std::string& source_filepath,
+    const Vectors4d& positions_world,
+    const Vectors2d& positions_texture,
+    const Triangles& triangles,
+    const Shapes& shapes,
+    const Textures& textures);
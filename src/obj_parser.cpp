@@ -0,0 +1,452 @@
+#include "obj_parser.hpp"
+
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "memory_map.hpp"
+#include "parallel.hpp"
+#include "tiny_obj_loader.h"
+
+namespace
+{
+
+const size_t MIN_CHUNK_SIZE = 1 << 20;
+const int64_t NO_INDEX = -1;
+// Negative OBJ indices count backwards from the current vertex. They are
+// stored relative to the first vertex of the chunk, offset by this flag,
+// until the number of vertices in earlier chunks is known.
+const int64_t RELATIVE_INDEX = int64_t{1} << 62;
+
+enum class EventType { SHAPE, MATERIAL };
+
+struct Event
+{
+    EventType type;
+    size_t triangle;
+    std::string name;
+};
+
+struct Chunk
+{
+    const char* begin;
+    const char* end;
+    std::vector<double> positions;
+    std::vector<double> texcoords;
+    std::vector<int64_t> corner_positions;
+    std::vector<int64_t> corner_texcoords;
+    std::vector<Event> events;
+    std::vector<std::string> material_libraries;
+    size_t numPositions() const { return positions.size() / 3; }
+    size_t numTexcoords() const { return texcoords.size() / 2; }
+    size_t numTriangles() const { return corner_positions.size() / 3; }
+};
+
+// Consecutive triangles of one shape within one chunk.
+struct Piece
+{
+    size_t triangle_begin;
+    size_t triangle_end;
+    std::vector<int64_t> vertex_positions;
+    std::vector<int64_t> vertex_texcoords;
+    std::vector<size_t> corners;
+};
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+const char* skipSpaces(const char* p, const char* end)
+{
+    while (p < end && isSpace(*p)) ++p;
+    return p;
+}
+
+const char* skipToken(const char* p, const char* end)
+{
+    while (p < end && !isSpace(*p)) ++p;
+    return p;
+}
+
+bool startsWith(const char* p, const char* end, const char* keyword)
+{
+    const auto length = std::strlen(keyword);
+    return static_cast<size_t>(end - p) > length &&
+        std::memcmp(p, keyword, length) == 0 && isSpace(p[length]);
+}
+
+std::string parseName(const char* p, const char* end)
+{
+    p = skipSpaces(p, end);
+    return std::string(p, skipToken(p, end));
+}
+
+const char* parseDouble(const char* p, const char* end, double& value)
+{
+    p = skipSpaces(p, end);
+    if (p < end && *p == '+') ++p;
+    value = 0.0;
+    return std::from_chars(p, end, value).ptr;
+}
+
+int64_t encodeIndex(int64_t index, size_t num_before)
+{
+    if (index > 0) return index - 1;
+    if (index < 0) return RELATIVE_INDEX + static_cast<int64_t>(num_before) + index;
+    return 0;
+}
+
+int64_t decodeIndex(int64_t index, size_t chunk_base)
+{
+    if (index >= RELATIVE_INDEX / 2) return static_cast<int64_t>(chunk_base) + index - RELATIVE_INDEX;
+    return index;
+}
+
+void parseCorner(const char* p, const char* end, const Chunk& chunk, int64_t& position, int64_t& texcoord)
+{
+    auto index = int64_t{};
+    auto result = std::from_chars(p, end, index);
+    position = encodeIndex(index, chunk.numPositions());
+    texcoord = NO_INDEX;
+    if (result.ptr < end && *result.ptr == '/' && result.ptr + 1 < end && result.ptr[1] != '/')
+    {
+        result = std::from_chars(result.ptr + 1, end, index);
+        if (result.ec == std::errc{})
+            texcoord = encodeIndex(index, chunk.numTexcoords());
+    }
+}
+
+// Polygons are split into triangle fans like tinyobj does.
+void parseFace(const char* p, const char* end, Chunk& chunk)
+{
+    auto first_position = int64_t{};
+    auto first_texcoord = int64_t{};
+    auto previous_position = int64_t{};
+    auto previous_texcoord = int64_t{};
+    auto num_corners = 0;
+    for (p = skipSpaces(p, end); p < end; p = skipSpaces(skipToken(p, end), end))
+    {
+        auto position = int64_t{};
+        auto texcoord = int64_t{};
+        parseCorner(p, end, chunk, position, texcoord);
+        if (num_corners == 0)
+        {
+            first_position = position;
+            first_texcoord = texcoord;
+        }
+        if (num_corners >= 2)
+        {
+            chunk.corner_positions.push_back(first_position);
+            chunk.corner_positions.push_back(previous_position);
+            chunk.corner_positions.push_back(position);
+            chunk.corner_texcoords.push_back(first_texcoord);
+            chunk.corner_texcoords.push_back(previous_texcoord);
+            chunk.corner_texcoords.push_back(texcoord);
+        }
+        previous_position = position;
+        previous_texcoord = texcoord;
+        ++num_corners;
+    }
+}
+
+void parseLine(const char* p, const char* end, Chunk& chunk)
+{
+    if (p == end) return;
+    const auto is_keyword_end = end - p == 1 || isSpace(p[1]);
+
+    if (p[0] == 'v' && is_keyword_end)
+    {
+        auto x = 0.0;
+        auto y = 0.0;
+        auto z = 0.0;
+        p = parseDouble(p + 1, end, x);
+        p = parseDouble(p, end, y);
+        p = parseDouble(p, end, z);
+        chunk.positions.push_back(x);
+        chunk.positions.push_back(y);
+        chunk.positions.push_back(z);
+    }
+    else if (startsWith(p, end, "vt"))
+    {
+        auto u = 0.0;
+        auto v = 0.0;
+        p = parseDouble(p + 2, end, u);
+        p = parseDouble(p, end, v);
+        chunk.texcoords.push_back(u);
+        chunk.texcoords.push_back(v);
+    }
+    else if (p[0] == 'f' && is_keyword_end)
+    {
+        parseFace(p + 1, end, chunk);
+    }
+    else if ((p[0] == 'g' || p[0] == 'o') && is_keyword_end)
+    {
+        chunk.events.push_back({ EventType::SHAPE, chunk.numTriangles(), parseName(p + 1, end) });
+    }
+    else if (startsWith(p, end, "usemtl"))
+    {
+        chunk.events.push_back({ EventType::MATERIAL, chunk.numTriangles(), parseName(p + 6, end) });
+    }
+    else if (startsWith(p, end, "mtllib"))
+    {
+        chunk.material_libraries.push_back(parseName(p + 6, end));
+    }
+}
+
+void parseChunk(Chunk& chunk)
+{
+    auto line = chunk.begin;
+    while (line < chunk.end)
+    {
+        auto line_end = static_cast<const char*>(std::memchr(line, '\n', chunk.end - line));
+        const auto next_line = line_end ? line_end + 1 : chunk.end;
+        if (!line_end) line_end = chunk.end;
+        if (line_end > line && line_end[-1] == '\r') --line_end;
+        parseLine(skipSpaces(line, line_end), line_end, chunk);
+        line = next_line;
+    }
+}
+
+std::vector<Chunk> splitIntoChunks(const MemoryMap& memory_map)
+{
+    const auto size = memory_map.size();
+    const auto num_chunks = std::max<size_t>(1, std::min(4 * numThreads(), size / MIN_CHUNK_SIZE));
+    auto chunks = std::vector<Chunk>(num_chunks);
+    auto begin = memory_map.begin();
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        auto end = std::max(begin, memory_map.begin() + (i + 1) * size / num_chunks);
+        if (end < memory_map.end())
+        {
+            const auto newline = static_cast<const char*>(std::memchr(end, '\n', memory_map.end() - end));
+            end = newline ? newline + 1 : memory_map.end();
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = end;
+        begin = end;
+    }
+    return chunks;
+}
+
+// Merges the (position, texcoord) pairs of the piece into vertices.
+void makePieceVertices(Piece& piece,
+    const std::vector<size_t>& corner_positions, const std::vector<int64_t>& corner_texcoords)
+{
+    auto vertex_indices = std::unordered_map<uint64_t, size_t>{};
+    vertex_indices.reserve(3 * (piece.triangle_end - piece.triangle_begin));
+    for (auto c = 3 * piece.triangle_begin; c < 3 * piece.triangle_end; ++c)
+    {
+        const auto position = corner_positions[c];
+        const auto texcoord = corner_texcoords[c];
+        const auto key = (uint64_t{position} << 32) | static_cast<uint32_t>(texcoord + 1);
+        const auto inserted = vertex_indices.emplace(key, piece.vertex_positions.size());
+        if (inserted.second)
+        {
+            piece.vertex_positions.push_back(position);
+            piece.vertex_texcoords.push_back(texcoord);
+        }
+        piece.corners.push_back(inserted.first->second);
+    }
+}
+
+} // namespace
+
+bool loadObjParallel(
+    const std::string& filepath,
+    Vectors4d& positions_world,
+    Vectors2d& positions_texture,
+    Triangles& triangles,
+    Shapes& shapes,
+    Textures& textures)
+{
+    using namespace std;
+
+    const auto memory_map = MemoryMap(filepath);
+    if (memory_map.empty())
+    {
+        cerr << "Could not read " << filepath << endl;
+        return false;
+    }
+
+    cout << "Loading model..." << endl;
+
+    auto chunks = splitIntoChunks(memory_map);
+    const auto num_chunks = chunks.size();
+    parallelFor(num_chunks, [&](size_t i) { parseChunk(chunks[i]); });
+
+    const auto dirpath = getDirectoryPath(filepath);
+    auto materials = vector<tinyobj::material_t>{};
+    auto material_map = map<string, int>{};
+    for (const auto& chunk : chunks)
+    {
+        for (const auto& material_library : chunk.material_libraries)
+        {
+            auto file = ifstream(dirpath + material_library);
+            if (file)
+                tinyobj::LoadMtl(material_map, materials, file);
+            else
+                cerr << "Could not read " << dirpath + material_library << endl;
+        }
+    }
+
+    // Where each chunk starts in the merged arrays, and the material and
+    // shape state at the start of each chunk.
+    auto position_bases = vector<size_t>(num_chunks + 1, 0);
+    auto texcoord_bases = vector<size_t>(num_chunks + 1, 0);
+    auto triangle_bases = vector<size_t>(num_chunks + 1, 0);
+    auto start_materials = vector<int>(num_chunks, -1);
+    auto shape_begins = vector<size_t>{0};
+    auto material = -1;
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        position_bases[i + 1] = position_bases[i] + chunks[i].numPositions();
+        texcoord_bases[i + 1] = texcoord_bases[i] + chunks[i].numTexcoords();
+        triangle_bases[i + 1] = triangle_bases[i] + chunks[i].numTriangles();
+        start_materials[i] = material;
+        for (const auto& event : chunks[i].events)
+        {
+            if (event.type == EventType::MATERIAL)
+            {
+                const auto it = material_map.find(event.name);
+                material = it == material_map.end() ? -1 : it->second;
+            }
+            else if (triangle_bases[i] + event.triangle > shape_begins.back())
+            {
+                shape_begins.push_back(triangle_bases[i] + event.triangle);
+            }
+        }
+    }
+    const auto num_positions = position_bases.back();
+    const auto num_texcoords = texcoord_bases.back();
+    const auto num_triangles = triangle_bases.back();
+    if (shape_begins.back() == num_triangles)
+        shape_begins.pop_back();
+
+    cout << "# of shapes    : " << shape_begins.size() << endl;
+    cout << "# of materials : " << materials.size() << endl;
+
+    // Resolve the indices of all chunks against the merged arrays.
+    const auto no_material = materials.size();
+    auto all_positions = vector<double>(3 * num_positions);
+    auto all_texcoords = vector<double>(2 * num_texcoords);
+    auto corner_positions = vector<size_t>(3 * num_triangles);
+    auto corner_texcoords = vector<int64_t>(3 * num_triangles);
+    triangles.texture_indices.resize(num_triangles);
+    auto valid = atomic<bool>{true};
+
+    parallelFor(num_chunks, [&](size_t i)
+    {
+        const auto& chunk = chunks[i];
+        copy(chunk.positions.begin(), chunk.positions.end(), all_positions.begin() + 3 * position_bases[i]);
+        copy(chunk.texcoords.begin(), chunk.texcoords.end(), all_texcoords.begin() + 2 * texcoord_bases[i]);
+
+        const auto corner_base = 3 * triangle_bases[i];
+        for (size_t c = 0; c < chunk.corner_positions.size(); ++c)
+        {
+            const auto position = decodeIndex(chunk.corner_positions[c], position_bases[i]);
+            auto texcoord = chunk.corner_texcoords[c];
+            if (texcoord != NO_INDEX)
+                texcoord = decodeIndex(texcoord, texcoord_bases[i]);
+            if (position < 0 || num_positions <= static_cast<size_t>(position))
+                valid = false;
+            if (texcoord < NO_INDEX || static_cast<int64_t>(num_texcoords) <= texcoord)
+                texcoord = NO_INDEX;
+            corner_positions[corner_base + c] = static_cast<size_t>(position);
+            corner_texcoords[corner_base + c] = texcoord;
+        }
+
+        auto current_material = start_materials[i];
+        auto event = chunk.events.begin();
+        for (size_t t = 0; t < chunk.numTriangles(); ++t)
+        {
+            for (; event != chunk.events.end() && event->triangle <= t; ++event)
+            {
+                if (event->type != EventType::MATERIAL) continue;
+                const auto it = material_map.find(event->name);
+                current_material = it == material_map.end() ? -1 : it->second;
+            }
+            triangles.texture_indices[triangle_bases[i] + t] =
+                current_material < 0 ? no_material : current_material;
+        }
+    });
+
+    if (!valid)
+    {
+        cerr << "Invalid vertex index in " << filepath << endl;
+        return false;
+    }
+
+    // Split the shapes at the chunk boundaries and make vertices per piece.
+    auto piece_begins = shape_begins;
+    piece_begins.insert(piece_begins.end(), triangle_bases.begin(), triangle_bases.end() - 1);
+    sort(piece_begins.begin(), piece_begins.end());
+    piece_begins.erase(unique(piece_begins.begin(), piece_begins.end()), piece_begins.end());
+    while (!piece_begins.empty() && piece_begins.back() >= num_triangles)
+        piece_begins.pop_back();
+
+    auto pieces = vector<Piece>(piece_begins.size());
+    for (size_t p = 0; p < pieces.size(); ++p)
+    {
+        pieces[p].triangle_begin = piece_begins[p];
+        pieces[p].triangle_end = p + 1 < pieces.size() ? piece_begins[p + 1] : num_triangles;
+    }
+    parallelFor(pieces.size(), [&](size_t p)
+    {
+        makePieceVertices(pieces[p], corner_positions, corner_texcoords);
+    });
+
+    auto vertex_bases = vector<size_t>(pieces.size() + 1, 0);
+    for (size_t p = 0; p < pieces.size(); ++p)
+        vertex_bases[p + 1] = vertex_bases[p] + pieces[p].vertex_positions.size();
+
+    positions_world = Vectors4d(vertex_bases.back());
+    positions_texture = Vectors2d(vertex_bases.back());
+    triangles.indices0.resize(num_triangles);
+    triangles.indices1.resize(num_triangles);
+    triangles.indices2.resize(num_triangles);
+
+    parallelFor(pieces.size(), [&](size_t p)
+    {
+        const auto& piece = pieces[p];
+        const auto vertex_base = vertex_bases[p];
+        for (size_t v = 0; v < piece.vertex_positions.size(); ++v)
+        {
+            const auto position = piece.vertex_positions[v];
+            const auto texcoord = piece.vertex_texcoords[v];
+            positions_world[vertex_base + v] = Vector4d{
+                all_positions[3 * position + 0],
+                all_positions[3 * position + 1],
+                all_positions[3 * position + 2],
+                1.0 };
+            positions_texture[vertex_base + v] = texcoord == NO_INDEX ? Vector2d{ 0.0, 0.0 } :
+                Vector2d{ all_texcoords[2 * texcoord + 0], all_texcoords[2 * texcoord + 1] };
+        }
+        for (auto t = piece.triangle_begin; t < piece.triangle_end; ++t)
+        {
+            const auto c = 3 * (t - piece.triangle_begin);
+            triangles.indices0[t] = vertex_base + piece.corners[c + 0];
+            triangles.indices1[t] = vertex_base + piece.corners[c + 1];
+            triangles.indices2[t] = vertex_base + piece.corners[c + 2];
+        }
+    });
+
+    shapes.triangle_begins = shape_begins;
+    shapes.triangle_ends.assign(shape_begins.begin() + 1, shape_begins.end());
+    if (!shape_begins.empty())
+        shapes.triangle_ends.push_back(num_triangles);
+    computeBoundingBoxes(positions_world, triangles, shapes);
+
+    auto texture_filenames = vector<string>{};
+    for (const auto& material : materials)
+        texture_filenames.push_back(material.ambient_texname);
+    texture_filenames.push_back("");
+    textures = readTextures(texture_filenames, dirpath);
+    return true;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+#include "mesh.hpp"
+#include "texture.hpp"
+#include "vector_space.hpp"
+
+// Imports an OBJ file without tinyobj. The file is memory mapped, split
+// into chunks at line boundaries and the chunks are parsed in parallel.
+// Each group or object becomes a shape like in loadObj, but a vertex is
+// only shared between triangles of the same shape and chunk.
+// Returns false if the file could not be read.
+bool loadObjParallel(
+    const std::string& filepath,
+    Vectors4d& positions_world,
+    Vectors2d& positions_texture,
+    Triangles& triangles,
+    Shapes& shapes,
+    Textures& textures);
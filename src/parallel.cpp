@@ -0,0 +1,97 @@
+#include "parallel.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// Workers that wait for jobs, so parallelFor does not start and join
+// threads on each call. The newest job is worked on first, so a nested
+// parallelFor is finished before its caller takes the next index.
+class ThreadPool
+{
+public:
+    ThreadPool() : stopping_(false)
+    {
+        for (size_t t = 1; t < numThreads(); ++t)
+            threads_.emplace_back([this]() { work(); });
+    }
+    ~ThreadPool()
+    {
+        {
+            auto lock = std::lock_guard<std::mutex>(mutex_);
+            stopping_ = true;
+        }
+        job_added_.notify_all();
+        for (auto& thread : threads_)
+            thread.join();
+    }
+    void run(ParallelJob& job)
+    {
+        {
+            auto lock = std::lock_guard<std::mutex>(mutex_);
+            jobs_.push_back(&job);
+        }
+        job_added_.notify_all();
+        takeIndices(job);
+        // No worker joins the job after it is removed, so only the ones
+        // that already took an index are waited for.
+        auto lock = std::unique_lock<std::mutex>(mutex_);
+        remove(job);
+        worker_done_.wait(lock, [&]() { return job.num_workers == 0; });
+        if (PIPELINE_COUNTERS_ENABLED)
+            pipelineCounters() += job.worker_counters;
+    }
+private:
+    static void takeIndices(ParallelJob& job)
+    {
+        for (auto i = job.next++; i < job.count; i = job.next++)
+            job.call(job.function, i);
+    }
+    void remove(ParallelJob& job)
+    {
+        const auto it = std::find(jobs_.begin(), jobs_.end(), &job);
+        if (it != jobs_.end())
+            jobs_.erase(it);
+    }
+    void work()
+    {
+        auto lock = std::unique_lock<std::mutex>(mutex_);
+        for (;;)
+        {
+            job_added_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+            if (stopping_)
+                return;
+            auto& job = *jobs_.back();
+            ++job.num_workers;
+            lock.unlock();
+            const auto counters_before = pipelineCounters();
+            takeIndices(job);
+            auto counters = pipelineCounters();
+            counters -= counters_before;
+            lock.lock();
+            job.worker_counters += counters;
+            // All indices are taken, so the other workers skip the job.
+            remove(job);
+            if (--job.num_workers == 0)
+                worker_done_.notify_all();
+        }
+    }
+    std::mutex mutex_;
+    std::condition_variable job_added_;
+    std::condition_variable worker_done_;
+    std::vector<ParallelJob*> jobs_;
+    std::vector<std::thread> threads_;
+    bool stopping_;
+};
+
+} // namespace
+
+void runParallelJob(ParallelJob& job)
+{
+    static auto thread_pool = ThreadPool{};
+    thread_pool.run(job);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "counters.hpp"
+
+inline size_t numThreads()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// The indices of a parallelFor, which the calling thread and any idle
+// workers of the thread pool take one at a time.
+struct ParallelJob
+{
+    void (*call)(void* function, size_t i);
+    void* function;
+    size_t count;
+    std::atomic<size_t> next{0};
+    // Workers that are taking indices, and the pipeline counts they made,
+    // guarded by the mutex of the pool.
+    size_t num_workers = 0;
+    PipelineCounters worker_counters;
+};
+
+// Runs the job on the calling thread and on the workers of a thread pool
+// that is started on the first call, and returns when all indices are done.
+// The pipeline counts of the workers are added to the calling thread.
+void runParallelJob(ParallelJob& job);
+
+// Calls function(i) for i in [0, count) on all hardware threads. The
+// threads are reused across calls, and calls can be nested or made from
+// several threads at once.
+template<typename Function>
+void parallelFor(size_t count, Function function)
+{
+    if (count <= 1 || numThreads() <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            function(i);
+        return;
+    }
+    auto job = ParallelJob{};
+    job.call = [](void* f, size_t i) { (*static_cast<Function*>(f))(i); };
+    job.function = &function;
+    job.count = count;
+    runParallelJob(job);
+}
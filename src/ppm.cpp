@@ -0,0 +1,99 @@
+#include "ppm.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+
+bool isLittleEndian()
+{
+    const auto one = uint16_t{1};
+    auto byte = uint8_t{};
+    std::memcpy(&byte, &one, 1);
+    return byte == 1;
+}
+
+// Reads the magic number, width, height and the number after them, and the
+// single whitespace that ends the header.
+bool readHeader(std::istream& file, const std::string& magic, size_t& width, size_t& height, double& value)
+{
+    auto file_magic = std::string{};
+    if (!(file >> file_magic) || file_magic != magic) return false;
+    if (!(file >> width >> height >> value)) return false;
+    file.get();
+    return true;
+}
+
+} // namespace
+
+bool savePpm(const std::string& filepath, const Pixels& pixels)
+{
+    auto bytes = std::vector<char>(3 * pixels.size());
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+        const auto color = pixels.colors[i];
+        bytes[3 * i + 0] = static_cast<char>((color >> 16) & 0xFF);
+        bytes[3 * i + 1] = static_cast<char>((color >> 8) & 0xFF);
+        bytes[3 * i + 2] = static_cast<char>(color & 0xFF);
+    }
+    auto file = std::ofstream(filepath, std::ios::binary);
+    file << "P6\n" << pixels.width << " " << pixels.height << "\n255\n";
+    file.write(bytes.data(), bytes.size());
+    return file.good();
+}
+
+bool loadPpm(const std::string& filepath, Pixels& pixels)
+{
+    auto file = std::ifstream(filepath, std::ios::binary);
+    auto width = size_t{};
+    auto height = size_t{};
+    auto max_value = 0.0;
+    if (!readHeader(file, "P6", width, height, max_value) || max_value != 255.0) return false;
+    auto bytes = std::vector<unsigned char>(3 * width * height);
+    if (!file.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) return false;
+    pixels.resize(width, height);
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+        pixels.colors[i] = 0xFF000000 | (Pixel(bytes[3 * i + 0]) << 16) |
+            (Pixel(bytes[3 * i + 1]) << 8) | Pixel(bytes[3 * i + 2]);
+    }
+    return true;
+}
+
+bool savePfm(const std::string& filepath, const Pixels& pixels)
+{
+    // PFM stores the rows from the bottom up, and a negative scale means
+    // little endian.
+    auto floats = std::vector<float>(pixels.size());
+    for (size_t y = 0; y < pixels.height; ++y)
+    {
+        for (size_t x = 0; x < pixels.width; ++x)
+            floats[(pixels.height - 1 - y) * pixels.width + x] = static_cast<float>(pixels.disparities[y * pixels.width + x]);
+    }
+    auto file = std::ofstream(filepath, std::ios::binary);
+    file << "Pf\n" << pixels.width << " " << pixels.height << "\n" << (isLittleEndian() ? "-1.0" : "1.0") << "\n";
+    file.write(reinterpret_cast<const char*>(floats.data()), floats.size() * sizeof(float));
+    return file.good();
+}
+
+bool loadPfm(const std::string& filepath, Pixels& pixels)
+{
+    auto file = std::ifstream(filepath, std::ios::binary);
+    auto width = size_t{};
+    auto height = size_t{};
+    auto scale = 0.0;
+    if (!readHeader(file, "Pf", width, height, scale)) return false;
+    if (width != pixels.width || height != pixels.height) return false;
+    if ((scale < 0.0) != isLittleEndian()) return false;
+    auto floats = std::vector<float>(width * height);
+    if (!file.read(reinterpret_cast<char*>(floats.data()), floats.size() * sizeof(float))) return false;
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+            pixels.disparities[y * width + x] = floats[(height - 1 - y) * width + x];
+    }
+    return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+#include "drawing.hpp"
+
+// Writes the colors as a binary PPM image, without the alpha channel.
+bool savePpm(const std::string& filepath, const Pixels& pixels);
+// Reads a binary PPM image into the colors, with an opaque alpha channel,
+// and resizes the pixels to it.
+bool loadPpm(const std::string& filepath, Pixels& pixels);
+// Writes the disparities as a grayscale PFM image of 32-bit floats.
+bool savePfm(const std::string& filepath, const Pixels& pixels);
+// Reads a grayscale PFM image into the disparities. It must have the size
+// of the pixels.
+bool loadPfm(const std::string& filepath, Pixels& pixels);
@@ -0,0 +1,305 @@
+#include "pvs.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+
+#include "algorithm.hpp"
+#include "drawing.hpp"
+#include "drawing_template.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+
+const char MAGIC[8] = {'R', 'A', 'S', 'T', 'P', 'V', 'S', '\0'};
+const uint32_t VERSION = 2;
+const Pixel NO_SHAPE = 0xFFFFFFFF;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t size_of_size_t;
+    double grid_min[3];
+    double cell_size;
+    uint64_t num_cells_x;
+    uint64_t num_cells_y;
+    uint64_t num_cells_z;
+    uint64_t num_shapes;
+    uint64_t num_entries;
+    uint64_t mesh_hash;
+};
+
+// FNV-1a over 64-bit words instead of bytes.
+class Hash
+{
+public:
+    template<typename T>
+    void add(const T* values, size_t count)
+    {
+        static_assert(sizeof(T) % sizeof(uint64_t) == 0, "Values must be whole words");
+        auto word = uint64_t{};
+        const auto bytes = reinterpret_cast<const char*>(values);
+        for (size_t i = 0; i < count * sizeof(T); i += sizeof(word))
+        {
+            std::memcpy(&word, bytes + i, sizeof(word));
+            value_ = (value_ ^ word) * 0x100000001B3;
+        }
+        add(count);
+    }
+    void add(uint64_t word) { value_ = (value_ ^ word) * 0x100000001B3; }
+    uint64_t value() const { return value_; }
+private:
+    uint64_t value_ = 0xCBF29CE484222325;
+};
+
+// The cells must list shapes of the mesh in increasing ranges.
+bool isValid(const PotentiallyVisibleSets& pvs)
+{
+    if (pvs.cell_begins.empty() || pvs.cell_begins.front() != 0 || pvs.cell_begins.back() != pvs.shapes.size())
+        return false;
+    for (size_t i = 1; i < pvs.cell_begins.size(); ++i)
+    {
+        if (pvs.cell_begins[i] < pvs.cell_begins[i - 1])
+            return false;
+    }
+    for (const auto shape : pvs.shapes)
+    {
+        if (shape >= pvs.num_shapes)
+            return false;
+    }
+    return true;
+}
+
+// Writes the shape index instead of a color.
+struct ShapeIdShader
+{
+    Pixels* pixels;
+    Pixel shape;
+    void operator()(const Vector4d& vertex, size_t index) const
+    {
+        if (vertex(0) < 0.0 || vertex(1) < 0.0 || vertex(2) < 0.0) return;
+        const auto disparity = vertex(3);
+        if (disparity <= pixels->disparities[index]) return;
+        pixels->disparities[index] = disparity;
+        pixels->colors[index] = shape;
+    }
+};
+
+void markVisibleShapes(Pixels& pixels, const Vertices& vertices, const Triangles& triangles,
+    const Shapes& shapes, const Environment& environment, std::vector<bool>& visible)
+{
+    const auto image_from_world = Matrix4d{
+        imageFromCamera(environment.intrinsics) * cameraFromWorld(environment.extrinsics) };
+
+    fill(pixels.disparities, 0.0);
+    fill(pixels.colors, NO_SHAPE);
+
+    auto shader = ShapeIdShader{ &pixels, 0 };
+    for (size_t s = 0; s < shapes.size(); ++s)
+    {
+        if (isOutsideFrustum(shapes.bounding_box_mins[s], shapes.bounding_box_maxs[s],
+            image_from_world, environment.intrinsics)) continue;
+
+        shader.shape = static_cast<Pixel>(s);
+        for (auto i = shapes.triangle_begins[s]; i < shapes.triangle_ends[s]; ++i)
+        {
+            const auto& v0 = vertices.positions_image[triangles.indices0[i]];
+            const auto& v1 = vertices.positions_image[triangles.indices1[i]];
+            const auto& v2 = vertices.positions_image[triangles.indices2[i]];
+
+            // The rasterizer skips triangles that reach behind the camera
+            // instead of clipping them, so count them as visible.
+            if (isBehindCamera(v0, v1, v2))
+            {
+                if (v0(2) > 0 || v1(2) > 0 || v2(2) > 0)
+                    visible[s] = true;
+                continue;
+            }
+            renderTriangleTemplate(v0, v1, v2,
+                Vector4d{ 1.0, 0.0, 0.0, v0(2) },
+                Vector4d{ 0.0, 1.0, 0.0, v1(2) },
+                Vector4d{ 0.0, 0.0, 1.0, v2(2) },
+                pixels.width, pixels.height, shader);
+        }
+    }
+
+    for (const auto shape : pixels.colors)
+    {
+        if (shape != NO_SHAPE)
+            visible[shape] = true;
+    }
+}
+
+} // namespace
+
+PotentiallyVisibleSets buildPotentiallyVisibleSets(
+    const Vectors4d& positions_world,
+    const Triangles& triangles,
+    const Shapes& shapes,
+    double cell_size,
+    size_t samples_per_cell,
+    size_t resolution)
+{
+    const auto infinity = std::numeric_limits<double>::infinity();
+    auto scene_min = Vector4d{ +infinity, +infinity, +infinity, 1.0 };
+    auto scene_max = Vector4d{ -infinity, -infinity, -infinity, 1.0 };
+    for (size_t s = 0; s < shapes.size(); ++s)
+    {
+        scene_min = scene_min.cwiseMin(shapes.bounding_box_mins[s]);
+        scene_max = scene_max.cwiseMax(shapes.bounding_box_maxs[s]);
+    }
+    const auto num_cells = [&](int axis)
+    {
+        return std::max<size_t>(1, static_cast<size_t>(std::ceil((scene_max(axis) - scene_min(axis)) / cell_size)));
+    };
+
+    auto potentially_visible_sets = PotentiallyVisibleSets{};
+    auto& pvs = potentially_visible_sets;
+    pvs.grid_min = scene_min;
+    pvs.cell_size = cell_size;
+    pvs.num_cells_x = num_cells(0);
+    pvs.num_cells_y = num_cells(1);
+    pvs.num_cells_z = num_cells(2);
+    pvs.num_shapes = shapes.size();
+    pvs.mesh_hash = hashMesh(positions_world, triangles, shapes);
+
+    auto cell_shapes = std::vector<std::vector<size_t>>(pvs.numCells());
+    parallelFor(pvs.numCells(), [&](size_t cell)
+    {
+        const auto x = cell % pvs.num_cells_x;
+        const auto y = cell / pvs.num_cells_x % pvs.num_cells_y;
+        const auto z = cell / pvs.num_cells_x / pvs.num_cells_y;
+        const auto cell_min = Vector4d{ pvs.grid_min + cell_size * Vector4d(double(x), double(y), double(z), 0.0) };
+
+        auto vertices = Vertices(positions_world.size());
+        vertices.positions_world = positions_world;
+        auto pixels = Pixels(resolution, resolution);
+        auto visible = std::vector<bool>(shapes.size(), false);
+        auto environment = Environment{ makeCameraIntrinsics(resolution, resolution), CameraExtrinsics{}, makeLight() };
+        auto generator = std::default_random_engine(static_cast<unsigned>(cell));
+        auto distribution = std::uniform_real_distribution<double>(0.0, cell_size);
+
+        for (size_t sample = 0; sample < samples_per_cell; ++sample)
+        {
+            auto position = Vector4d{ cell_min };
+            position(0) += distribution(generator);
+            position(1) += distribution(generator);
+            position(2) += distribution(generator);
+            for (int face = 0; face < NUM_CUBE_FACES; ++face)
+            {
+                environment.extrinsics = makeCubeFaceExtrinsics(position, face);
+                vertexShader(vertices, environment);
+                markVisibleShapes(pixels, vertices, triangles, shapes, environment, visible);
+            }
+        }
+        for (size_t s = 0; s < shapes.size(); ++s)
+        {
+            if (visible[s])
+                cell_shapes[cell].push_back(s);
+        }
+    });
+
+    pvs.cell_begins.push_back(0);
+    for (const auto& visible_shapes : cell_shapes)
+    {
+        pvs.shapes.insert(pvs.shapes.end(), visible_shapes.begin(), visible_shapes.end());
+        pvs.cell_begins.push_back(pvs.shapes.size());
+    }
+    return potentially_visible_sets;
+}
+
+uint64_t hashMesh(const Vectors4d& positions_world, const Triangles& triangles, const Shapes& shapes)
+{
+    auto hash = Hash{};
+    hash.add(positions_world.data(), positions_world.size());
+    hash.add(triangles.indices0.data(), triangles.indices0.size());
+    hash.add(triangles.indices1.data(), triangles.indices1.size());
+    hash.add(triangles.indices2.data(), triangles.indices2.size());
+    hash.add(shapes.triangle_begins.data(), shapes.triangle_begins.size());
+    hash.add(shapes.triangle_ends.data(), shapes.triangle_ends.size());
+    return hash.value();
+}
+
+bool findCell(const PotentiallyVisibleSets& potentially_visible_sets,
+    const CameraExtrinsics& extrinsics, size_t& cell)
+{
+    const auto& pvs = potentially_visible_sets;
+    const auto x = std::floor((extrinsics.x - pvs.grid_min(0)) / pvs.cell_size);
+    const auto y = std::floor((extrinsics.y - pvs.grid_min(1)) / pvs.cell_size);
+    const auto z = std::floor((extrinsics.z - pvs.grid_min(2)) / pvs.cell_size);
+    if (x < 0.0 || y < 0.0 || z < 0.0) return false;
+    if (x >= pvs.num_cells_x || y >= pvs.num_cells_y || z >= pvs.num_cells_z) return false;
+    cell = (static_cast<size_t>(z) * pvs.num_cells_y + static_cast<size_t>(y)) * pvs.num_cells_x + static_cast<size_t>(x);
+    return true;
+}
+
+bool savePotentiallyVisibleSets(const std::string& filepath,
+    const PotentiallyVisibleSets& potentially_visible_sets)
+{
+    const auto& pvs = potentially_visible_sets;
+    auto header = Header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.size_of_size_t = sizeof(size_t);
+    header.grid_min[0] = pvs.grid_min(0);
+    header.grid_min[1] = pvs.grid_min(1);
+    header.grid_min[2] = pvs.grid_min(2);
+    header.cell_size = pvs.cell_size;
+    header.num_cells_x = pvs.num_cells_x;
+    header.num_cells_y = pvs.num_cells_y;
+    header.num_cells_z = pvs.num_cells_z;
+    header.num_shapes = pvs.num_shapes;
+    header.num_entries = pvs.shapes.size();
+    header.mesh_hash = pvs.mesh_hash;
+
+    auto file = std::ofstream(filepath, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(pvs.cell_begins.data()), pvs.cell_begins.size() * sizeof(size_t));
+    file.write(reinterpret_cast<const char*>(pvs.shapes.data()), pvs.shapes.size() * sizeof(size_t));
+    return file.good();
+}
+
+bool loadPotentiallyVisibleSets(const std::string& filepath, uint64_t mesh_hash,
+    PotentiallyVisibleSets& potentially_visible_sets)
+{
+    auto file = std::ifstream(filepath, std::ios::binary | std::ios::ate);
+    const auto file_size = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+    auto header = Header{};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) return false;
+    if (header.version != VERSION || header.size_of_size_t != sizeof(size_t)) return false;
+    if (header.mesh_hash != mesh_hash) return false;
+    if (!(header.cell_size > 0.0) || !std::isfinite(header.cell_size)) return false;
+
+    // Checks the counts against the file size before allocating, without
+    // overflowing on corrupt counts.
+    const auto max_values = (file_size - sizeof(header)) / sizeof(size_t);
+    if (header.num_cells_x == 0 || header.num_cells_y == 0 || header.num_cells_z == 0) return false;
+    if (header.num_cells_y > max_values / header.num_cells_x) return false;
+    if (header.num_cells_z > max_values / (header.num_cells_x * header.num_cells_y)) return false;
+    const auto num_cells = header.num_cells_x * header.num_cells_y * header.num_cells_z;
+    if (num_cells >= max_values || header.num_entries != max_values - num_cells - 1) return false;
+
+    auto pvs = PotentiallyVisibleSets{};
+    pvs.grid_min = Vector4d{ header.grid_min[0], header.grid_min[1], header.grid_min[2], 1.0 };
+    pvs.cell_size = header.cell_size;
+    pvs.num_cells_x = header.num_cells_x;
+    pvs.num_cells_y = header.num_cells_y;
+    pvs.num_cells_z = header.num_cells_z;
+    pvs.num_shapes = header.num_shapes;
+    pvs.mesh_hash = header.mesh_hash;
+    pvs.cell_begins.resize(pvs.numCells() + 1);
+    pvs.shapes.resize(header.num_entries);
+    file.read(reinterpret_cast<char*>(pvs.cell_begins.data()), pvs.cell_begins.size() * sizeof(size_t));
+    file.read(reinterpret_cast<char*>(pvs.shapes.data()), pvs.shapes.size() * sizeof(size_t));
+    if (!file || !isValid(pvs)) return false;
+    potentially_visible_sets = pvs;
+    return true;
+}
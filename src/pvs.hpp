@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "camera.hpp"
+#include "mesh.hpp"
+#include "vector_space.hpp"
+
+// Potentially visible sets for a static scene. The bounding box of the
+// scene is divided into a grid of cubic cells, and each cell stores the
+// shapes that are visible from somewhere in the cell. The shapes of cell i
+// are shapes[cell_begins[i]] to shapes[cell_begins[i + 1] - 1].
+struct PotentiallyVisibleSets
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Vector4d grid_min = Vector4d::Zero();
+    double cell_size = 0.0;
+    size_t num_cells_x = 0;
+    size_t num_cells_y = 0;
+    size_t num_cells_z = 0;
+    size_t num_shapes = 0;
+    // The hashMesh of the mesh that the sets were built from.
+    uint64_t mesh_hash = 0;
+    std::vector<size_t> cell_begins;
+    std::vector<size_t> shapes;
+    bool empty() const { return cell_begins.empty(); }
+    size_t numCells() const { return num_cells_x * num_cells_y * num_cells_z; }
+};
+
+// Hashes the positions, the triangles and the shapes, which the potentially
+// visible sets depend on, to tell if a file was built from another mesh.
+uint64_t hashMesh(const Vectors4d& positions_world, const Triangles& triangles, const Shapes& shapes);
+
+// Renders shape ids with the rasterizer in all six directions from
+// samples_per_cell points in each cell, with square images of the given
+// resolution, and records which shapes cover any pixel.
+PotentiallyVisibleSets buildPotentiallyVisibleSets(
+    const Vectors4d& positions_world,
+    const Triangles& triangles,
+    const Shapes& shapes,
+    double cell_size,
+    size_t samples_per_cell,
+    size_t resolution);
+
+// Returns false if the camera is outside the grid, in which case all shapes
+// should be drawn.
+bool findCell(const PotentiallyVisibleSets& potentially_visible_sets,
+    const CameraExtrinsics& extrinsics, size_t& cell);
+
+bool savePotentiallyVisibleSets(const std::string& filepath,
+    const PotentiallyVisibleSets& potentially_visible_sets);
+// Returns false if the file is invalid or was built from a mesh with
+// another hash, in which case all shapes should be drawn.
+bool loadPotentiallyVisibleSets(const std::string& filepath, uint64_t mesh_hash,
+    PotentiallyVisibleSets& potentially_visible_sets);
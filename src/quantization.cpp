@@ -0,0 +1,72 @@
+#include "quantization.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+const double MAX_INTEGER = 65535.0;
+
+uint16_t quantize(double value, double offset, double scale)
+{
+    if (scale <= 0.0) return 0;
+    return static_cast<uint16_t>(std::min(MAX_INTEGER, std::round((value - offset) / scale)));
+}
+
+} // namespace
+
+QuantizedAttributes quantizeAttributes(const Vectors4d& positions_world, const Vectors2d& positions_texture)
+{
+    const auto num_vertices = positions_world.size();
+    const auto num_chunks = (num_vertices + QUANTIZATION_CHUNK_SIZE - 1) / QUANTIZATION_CHUNK_SIZE;
+
+    auto quantized = QuantizedAttributes{};
+    quantized.positions.resize(3 * num_vertices);
+    quantized.texcoords.resize(2 * num_vertices);
+    quantized.position_offsets.resize(num_chunks);
+    quantized.position_scales.resize(num_chunks);
+    quantized.texture_offsets.resize(num_chunks);
+    quantized.texture_scales.resize(num_chunks);
+
+    for (size_t chunk = 0; chunk < num_chunks; ++chunk)
+    {
+        const auto begin = chunk * QUANTIZATION_CHUNK_SIZE;
+        const auto end = std::min(num_vertices, begin + QUANTIZATION_CHUNK_SIZE);
+
+        auto position_min = Vector4d{ positions_world[begin] };
+        auto position_max = Vector4d{ positions_world[begin] };
+        auto texture_min = Vector2d{ positions_texture[begin] };
+        auto texture_max = Vector2d{ positions_texture[begin] };
+        for (auto i = begin; i < end; ++i)
+        {
+            position_min = position_min.cwiseMin(positions_world[i]);
+            position_max = position_max.cwiseMax(positions_world[i]);
+            texture_min = texture_min.cwiseMin(positions_texture[i]);
+            texture_max = texture_max.cwiseMax(positions_texture[i]);
+        }
+        const auto position_scale = Vector4d{ (position_max - position_min) / MAX_INTEGER };
+        const auto texture_scale = Vector2d{ (texture_max - texture_min) / MAX_INTEGER };
+        quantized.position_offsets[chunk] = Vector4d{ position_min(0), position_min(1), position_min(2), 1.0 };
+        quantized.position_scales[chunk] = Vector4d{ position_scale(0), position_scale(1), position_scale(2), 0.0 };
+        quantized.texture_offsets[chunk] = texture_min;
+        quantized.texture_scales[chunk] = texture_scale;
+
+        for (auto i = begin; i < end; ++i)
+        {
+            for (int k = 0; k < 3; ++k)
+                quantized.positions[3 * i + k] = quantize(positions_world[i](k), position_min(k), position_scale(k));
+            for (int k = 0; k < 2; ++k)
+                quantized.texcoords[2 * i + k] = quantize(positions_texture[i](k), texture_min(k), texture_scale(k));
+        }
+    }
+    return quantized;
+}
+
+Matrix4d worldFromQuantized(const QuantizedAttributes& quantized, size_t chunk)
+{
+    auto world_from_quantized = Matrix4d{ Matrix4d::Identity() };
+    world_from_quantized.diagonal().head<3>() = quantized.position_scales[chunk].head<3>();
+    world_from_quantized.col(3) = quantized.position_offsets[chunk];
+    return world_from_quantized;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "vector_space.hpp"
+
+const size_t QUANTIZATION_CHUNK_SIZE = 4096;
+
+// Vertex attributes stored as 16-bit integers relative to the bounding box
+// of each chunk of QUANTIZATION_CHUNK_SIZE consecutive vertices. Vertices
+// that are close in memory are close in space after welding, so the boxes
+// are small. A world position is offset + scale * (x, y, z, 0) of its chunk.
+struct QuantizedAttributes
+{
+    std::vector<uint16_t> positions;
+    std::vector<uint16_t> texcoords;
+    Vectors4d position_offsets;
+    Vectors4d position_scales;
+    Vectors2d texture_offsets;
+    Vectors2d texture_scales;
+    bool empty() const { return positions.empty(); }
+    size_t size() const { return positions.size() / 3; }
+    size_t numChunks() const { return position_offsets.size(); }
+};
+
+QuantizedAttributes quantizeAttributes(const Vectors4d& positions_world, const Vectors2d& positions_texture);
+
+// The transform from the integer positions of a chunk to world coordinates.
+Matrix4d worldFromQuantized(const QuantizedAttributes& quantized, size_t chunk);
+
+inline Vector4d dequantizePosition(const QuantizedAttributes& quantized, size_t i)
+{
+    const auto chunk = i / QUANTIZATION_CHUNK_SIZE;
+    const auto integer = Vector4d{
+        double(quantized.positions[3 * i + 0]),
+        double(quantized.positions[3 * i + 1]),
+        double(quantized.positions[3 * i + 2]),
+        0.0 };
+    return quantized.position_offsets[chunk] + quantized.position_scales[chunk].cwiseProduct(integer);
+}
+
+inline Vector2d dequantizeTexture(const QuantizedAttributes& quantized, size_t i)
+{
+    const auto chunk = i / QUANTIZATION_CHUNK_SIZE;
+    const auto integer = Vector2d{
+        double(quantized.texcoords[2 * i + 0]),
+        double(quantized.texcoords[2 * i + 1]) };
+    return quantized.texture_offsets[chunk] + quantized.texture_scales[chunk].cwiseProduct(integer);
+}
@@ -0,0 +1,77 @@
+#include "recording.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+namespace
+{
+
+// Larger resolutions are taken for corrupt lines rather than allocated.
+const int64_t MAX_RESOLUTION = 16384;
+
+} // namespace
+
+bool loadRecording(const std::string& filepath, Environments& environments)
+{
+    auto file = std::ifstream(filepath);
+    if (!file) return false;
+    auto recording = Environments{};
+    auto line = std::string{};
+    while (std::getline(file, line))
+    {
+        const auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+        auto stream = std::istringstream(line);
+        auto environment = Environment{ CameraIntrinsics{}, CameraExtrinsics{}, makeLight() };
+        auto& extrinsics = environment.extrinsics;
+        if (!(stream >> extrinsics.x >> extrinsics.y >> extrinsics.z >> extrinsics.yaw >> extrinsics.pitch))
+            return false;
+        // Lines of camera paths end here.
+        auto light = Vector4d{ 0.0, 0.0, 0.0, 1.0 };
+        auto debug_view = int{DEBUG_VIEW_NONE};
+        // Signed, since unsigned streams wrap negative numbers around.
+        auto width = int64_t{};
+        auto height = int64_t{};
+        if (stream >> light(0) >> light(1) >> light(2))
+        {
+            environment.light.position_world = light;
+            if (stream >> debug_view)
+            {
+                if (debug_view < DEBUG_VIEW_NONE || debug_view > DEBUG_VIEW_TRIANGLES_PER_TILE)
+                    return false;
+                environment.debug_view = static_cast<DebugView>(debug_view);
+            }
+            if (stream >> width >> height)
+            {
+                if (width < 1 || width > MAX_RESOLUTION || height < 1 || height > MAX_RESOLUTION)
+                    return false;
+                environment.intrinsics = makeCameraIntrinsics(static_cast<size_t>(width), static_cast<size_t>(height));
+            }
+        }
+        recording.push_back(environment);
+    }
+    environments = recording;
+    return true;
+}
+
+bool saveRecording(const std::string& filepath, const Environments& environments)
+{
+    auto file = std::ofstream(filepath);
+    // Writes enough digits to read back the same doubles.
+    file << std::setprecision(std::numeric_limits<double>::max_digits10);
+    file << "# x y z yaw pitch light_x light_y light_z debug_view width height\n";
+    for (const auto& environment : environments)
+    {
+        const auto& extrinsics = environment.extrinsics;
+        const auto& light = environment.light.position_world;
+        file << extrinsics.x << " " << extrinsics.y << " " << extrinsics.z << " "
+             << extrinsics.yaw << " " << extrinsics.pitch << " "
+             << light(0) << " " << light(1) << " " << light(2) << " "
+             << int{environment.debug_view} << " "
+             << environment.intrinsics.width << " " << environment.intrinsics.height << "\n";
+    }
+    return file.good();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "drawing.hpp"
+
+using Environments = std::vector<Environment, Eigen::aligned_allocator<Environment>>;
+
+// A recording is a text file with the environment of one frame per line,
+// as the camera x y z yaw pitch, the light x y z, the debug view and the
+// render width and height. It starts like a camera path, so the tools that
+// read camera paths can play back the camera of a recording, and a camera
+// path can be replayed with the light of makeLight. The intrinsics are
+// made with makeCameraIntrinsics from the render resolution, and are zero
+// for lines without it. Recordings with a resolution outside 1 to 16384 or
+// an unknown debug view are rejected.
+bool loadRecording(const std::string& filepath, Environments& environments);
+bool saveRecording(const std::string& filepath, const Environments& environments);
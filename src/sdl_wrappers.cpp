@@ -69,6 +69,8 @@ Sdl::Sdl(const char* window_title, int width, int height)
         SDL_TEXTUREACCESS_STREAMING,
         width,
         height);
+    texture_width = width;
+    texture_height = height;
 
     // TODO: handle texture failing.
 
@@ -96,9 +98,86 @@ int Sdl::pitch() const
 
 void Sdl::update()
 {
-    SDL_UpdateTexture(texture, nullptr, pixels.data(), pitch());
+    update(pixels.data());
+}
+
+void Sdl::update(const Uint32* pixels_begin)
+{
+    update(pixels_begin, width, height);
+}
+
+void Sdl::update(const Uint32* pixels_begin, int pixels_width, int pixels_height)
+{
+    if (pixels_width > texture_width || pixels_height > texture_height)
+    {
+        if (!resizeTexture(pixels_width, pixels_height))
+            return;
+    }
+    const auto source = SDL_Rect{ 0, 0, pixels_width, pixels_height };
+    SDL_UpdateTexture(texture, &source, pixels_begin, pixels_width * sizeof(pixels.front()));
+    present(source);
+}
+
+Uint32* Sdl::lockPixels()
+{
+    return lockPixels(width, height);
+}
+
+Uint32* Sdl::lockPixels(int pixels_width, int pixels_height)
+{
+    // Locking a part of the texture gives the pitch of the whole texture,
+    // so the texture is resized to the frame instead.
+    if (!resizeTexture(pixels_width, pixels_height))
+        return nullptr;
+    locked_rect = SDL_Rect{ 0, 0, pixels_width, pixels_height };
+    auto data = static_cast<void*>(nullptr);
+    auto texture_pitch = 0;
+    if (SDL_LockTexture(texture, nullptr, &data, &texture_pitch) != 0)
+    {
+        printError("SDL_LockTexture");
+        return nullptr;
+    }
+    // The rasterizer needs the rows to be contiguous.
+    if (texture_pitch != pixels_width * static_cast<int>(sizeof(pixels.front())))
+    {
+        SDL_UnlockTexture(texture);
+        return nullptr;
+    }
+    return static_cast<Uint32*>(data);
+}
+
+void Sdl::presentLockedPixels()
+{
+    SDL_UnlockTexture(texture);
+    present(locked_rect);
+}
+
+bool Sdl::resizeTexture(int new_width, int new_height)
+{
+    if (new_width == texture_width && new_height == texture_height)
+        return true;
+    const auto new_texture = SDL_CreateTexture(
+        renderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STREAMING,
+        new_width,
+        new_height);
+    if (!new_texture)
+    {
+        printError("SDL_CreateTexture");
+        return false;
+    }
+    SDL_DestroyTexture(texture);
+    texture = new_texture;
+    texture_width = new_width;
+    texture_height = new_height;
+    return true;
+}
+
+void Sdl::present(const SDL_Rect& source)
+{
     SDL_RenderClear(renderer); // is this needed?
-    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+    SDL_RenderCopy(renderer, texture, &source, nullptr);
     SDL_RenderPresent(renderer);
 }
 
@@ -15,13 +15,33 @@ public:
     ~Sdl();
     void clear();
     void update();
+    // Uploads and presents the pixels without copying them first. Pixels
+    // smaller than the window are scaled up to fill it.
+    void update(const Uint32* pixels_begin);
+    void update(const Uint32* pixels_begin, int pixels_width, int pixels_height);
 	void setPixels(const Uint32* pixels_begin);
+    // Locks the streaming texture so a frame can be rendered directly into
+    // it. Returns nullptr if that is not possible, in which case setPixels
+    // and update should be used instead. The texture is recreated when the
+    // size of the frame changes, so the rows of the frame are contiguous.
+    // DynamicResolution only switches between a few sizes, at most every
+    // 30 frames.
+    Uint32* lockPixels();
+    Uint32* lockPixels(int pixels_width, int pixels_height);
+    // Unlocks and presents the texture, without copying the pixels.
+    void presentLockedPixels();
 private:
 	int pitch() const;
+    // Recreates the texture if it has another size.
+    bool resizeTexture(int new_width, int new_height);
+    void present(const SDL_Rect& source);
 	int width;
 	int height;
+    int texture_width;
+    int texture_height;
 	SDL_Window* window;
 	SDL_Renderer* renderer;
 	SDL_Texture* texture;
+    SDL_Rect locked_rect;
 	std::vector<Uint32> pixels;
 };
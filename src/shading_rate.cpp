@@ -0,0 +1,98 @@
+#include "shading_rate.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "parallel.hpp"
+
+namespace
+{
+
+// The gradients are measured across the borders of 4x4 blocks, which are
+// also borders of the smaller blocks, so a tile that was shaded coarsely
+// still shows its gradients.
+const size_t BLOCK_SIZE = 4;
+
+double luminance(Pixel color)
+{
+    const auto red = (color >> 16) & 0xFF;
+    const auto green = (color >> 8) & 0xFF;
+    const auto blue = color & 0xFF;
+    return 0.299 * red + 0.587 * green + 0.114 * blue;
+}
+
+} // namespace
+
+std::vector<ShadingRate> makeMaterialShadingRates(const Textures& textures)
+{
+    auto rates = std::vector<ShadingRate>(textures.size(), SHADING_RATE_1X1);
+    for (size_t i = 0; i < textures.size(); ++i)
+    {
+        if (textures[i].empty())
+            rates[i] = SHADING_RATE_2X2;
+    }
+    return rates;
+}
+
+void selectShadingRates(ShadingRates& shading_rates, const Pixels& pixels, double max_error)
+{
+    using namespace std;
+
+    auto& rates = shading_rates;
+    const auto width = pixels.width;
+    const auto height = pixels.height;
+    const auto num_tiles_x = (width + SHADING_RATE_TILE_SIZE - 1) / SHADING_RATE_TILE_SIZE;
+    const auto num_tiles_y = (height + SHADING_RATE_TILE_SIZE - 1) / SHADING_RATE_TILE_SIZE;
+    // The pixels were shaded with the current rates if they have the same size.
+    if (rates.width != width || rates.height != height)
+    {
+        rates.width = width;
+        rates.height = height;
+        rates.num_tiles_x = num_tiles_x;
+        rates.tiles.assign(num_tiles_x * num_tiles_y, SHADING_RATE_1X1);
+    }
+
+    parallelFor(num_tiles_y, [&](size_t tile_y)
+    {
+        const auto y_begin = tile_y * SHADING_RATE_TILE_SIZE;
+        const auto y_end = min(y_begin + SHADING_RATE_TILE_SIZE, height);
+        for (size_t tile_x = 0; tile_x < num_tiles_x; ++tile_x)
+        {
+            const auto x_begin = tile_x * SHADING_RATE_TILE_SIZE;
+            const auto x_end = min(x_begin + SHADING_RATE_TILE_SIZE, width);
+            auto& rate = rates.tiles[tile_y * num_tiles_x + tile_x];
+
+            auto step_x = 0.0;
+            auto step_y = 0.0;
+            for (auto y = y_begin; y < y_end; ++y)
+            {
+                for (auto x = x_begin + BLOCK_SIZE - 1; x < x_end && x + 1 < width; x += BLOCK_SIZE)
+                {
+                    const auto index = y * width + x;
+                    step_x = max(step_x, abs(luminance(pixels.colors[index + 1]) - luminance(pixels.colors[index])));
+                }
+            }
+            for (auto y = y_begin + BLOCK_SIZE - 1; y < y_end && y + 1 < height; y += BLOCK_SIZE)
+            {
+                for (auto x = x_begin; x < x_end; ++x)
+                {
+                    const auto index = y * width + x;
+                    step_y = max(step_y, abs(luminance(pixels.colors[index + width]) - luminance(pixels.colors[index])));
+                }
+            }
+            // A block of n pixels makes a step of n times the gradient at
+            // its border, and has an error of n - 1 times the gradient.
+            // Edges are steep gradients and keep their tiles fine.
+            const auto gradient_x = step_x / shadingRateWidth(rate);
+            const auto gradient_y = step_y / shadingRateHeight(rate);
+            if (3 * (gradient_x + gradient_y) <= max_error)
+                rate = SHADING_RATE_4X4;
+            else if (gradient_x + gradient_y <= max_error)
+                rate = SHADING_RATE_2X2;
+            else if (gradient_y <= max_error)
+                rate = SHADING_RATE_1X2;
+            else
+                rate = SHADING_RATE_1X1;
+        }
+    });
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "drawing.hpp"
+#include "texture.hpp"
+
+// Block of width x height pixels that share one shading result.
+enum ShadingRate : uint8_t
+{
+    SHADING_RATE_1X1,
+    SHADING_RATE_1X2,
+    SHADING_RATE_2X2,
+    SHADING_RATE_4X4,
+};
+
+const size_t SHADING_RATE_TILE_SIZE = 16;
+
+inline size_t shadingRateWidth(ShadingRate rate)
+{
+    return rate == SHADING_RATE_4X4 ? 4 : rate == SHADING_RATE_2X2 ? 2 : 1;
+}
+
+inline size_t shadingRateHeight(ShadingRate rate)
+{
+    return rate == SHADING_RATE_4X4 ? 4 : rate == SHADING_RATE_1X1 ? 1 : 2;
+}
+
+// The shading rate of each tile of pixels and of each material. A surface
+// is shaded at the coarser of the rate of its tile and of its material,
+// while its visibility and depth are still tested per pixel.
+struct ShadingRates
+{
+    size_t width = 0;
+    size_t height = 0;
+    size_t num_tiles_x = 0;
+    std::vector<ShadingRate> tiles;
+    // Indexed by texture index. Materials that are not in it are 1x1.
+    std::vector<ShadingRate> materials;
+    // Used by drawTriangles to store the triangle and the color that each
+    // block was shaded with, at the top left pixel of the block.
+    std::vector<size_t> block_triangles;
+    std::vector<Pixel> block_colors;
+
+    ShadingRate tile(size_t x, size_t y) const
+    {
+        return tiles[y / SHADING_RATE_TILE_SIZE * num_tiles_x + x / SHADING_RATE_TILE_SIZE];
+    }
+    ShadingRate material(size_t texture_index) const
+    {
+        return texture_index < materials.size() ? materials[texture_index] : SHADING_RATE_1X1;
+    }
+};
+
+// Hints that materials without a texture can be shaded at 2x2, since their
+// color only comes from smooth lighting.
+std::vector<ShadingRate> makeMaterialShadingRates(const Textures& textures);
+
+// Picks the rate of each tile for the next frame, as the coarsest rate
+// whose error is estimated to be at most max_error 8-bit levels from the
+// color gradients of the pixels of this frame. drawTriangles only uses
+// the rates for pixels of the same size.
+void selectShadingRates(ShadingRates& shading_rates, const Pixels& pixels, double max_error);
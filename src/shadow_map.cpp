@@ -0,0 +1,95 @@
+#include "shadow_map.hpp"
+
+#include <algorithm>
+
+#include "algorithm.hpp"
+#include "counters.hpp"
+#include "drawing.hpp"
+#include "drawing_template.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+
+// A surface is lit if it is at most this much further away from the light
+// than the closest surface, relative to its distance.
+const double SHADOW_BIAS = 0.02;
+// Light that still reaches shadowed surfaces, since there is no indirect
+// light.
+const double SHADOWED_LIGHT_FRACTION = 0.25;
+
+} // namespace
+
+double ShadowMap::lightFraction(const Vector4d& position_world) const
+{
+    // The position is in the face where it has the largest depth.
+    auto face = 0;
+    auto max_alignment = depth_from_world[0].dot(position_world);
+    for (int f = 1; f < NUM_CUBE_FACES; ++f)
+    {
+        const auto alignment = depth_from_world[f].dot(position_world);
+        if (alignment > max_alignment)
+        {
+            face = f;
+            max_alignment = alignment;
+        }
+    }
+    const auto p = Vector4d{ image_from_world[face] * position_world };
+    const auto last = static_cast<double>(resolution - 1);
+    const auto x = static_cast<size_t>(clamp(p(0) / p(3), 0.0, last));
+    const auto y = static_cast<size_t>(clamp(p(1) / p(3), 0.0, last));
+    const auto disparity = 1.0 / p(3);
+    const auto closest_disparity = disparities[(face * resolution + y) * resolution + x];
+    return disparity * (1.0 + SHADOW_BIAS) >= closest_disparity ? 1.0 : SHADOWED_LIGHT_FRACTION;
+}
+
+ShadowMap renderShadowMap(const Vertices& vertices, const Triangles& triangles, const Shapes& shapes,
+    const Vector4d& light_position_world, size_t resolution)
+{
+    // The shadow map is not part of the frame that it is rendered for.
+    const auto uncounted = UncountedScope{};
+    auto shadow_map = ShadowMap{};
+    shadow_map.light_position_world = light_position_world;
+    shadow_map.resolution = resolution;
+    shadow_map.disparities.resize(NUM_CUBE_FACES * resolution * resolution);
+
+    const auto intrinsics = makeCameraIntrinsics(resolution, resolution);
+    const auto image_from_camera = imageFromCamera(intrinsics);
+
+    parallelFor(NUM_CUBE_FACES, [&](size_t face)
+    {
+        const auto extrinsics = makeCubeFaceExtrinsics(light_position_world, static_cast<int>(face));
+        const auto camera_from_world = cameraFromWorld(extrinsics);
+        const auto image_from_world = Matrix4d{ image_from_camera * camera_from_world };
+        shadow_map.image_from_world[face] = image_from_world;
+        shadow_map.depth_from_world[face] = camera_from_world.row(2).transpose();
+
+        auto positions_image = Vectors4d(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            const auto position_image = Vector4d{ image_from_world * vertices.positionWorld(i) };
+            positions_image[i] = position_image / position_image(3);
+        }
+
+        const auto disparities = shadow_map.disparities.data() + face * resolution * resolution;
+        for (size_t s = 0; s < shapes.size(); ++s)
+        {
+            if (isOutsideFrustum(shapes.bounding_box_mins[s], shapes.bounding_box_maxs[s],
+                image_from_world, intrinsics)) continue;
+
+            for (auto i = shapes.triangle_begins[s]; i < shapes.triangle_ends[s]; ++i)
+            {
+                const auto& v0 = positions_image[triangles.indices0[i]];
+                const auto& v1 = positions_image[triangles.indices1[i]];
+                const auto& v2 = positions_image[triangles.indices2[i]];
+                if (isBehindCamera(v0, v1, v2)) continue;
+                renderTriangleTemplate(v0, v1, v2, resolution, resolution,
+                    [disparities](double disparity, size_t index)
+                {
+                    disparities[index] = std::max(disparities[index], static_cast<float>(disparity));
+                });
+            }
+        }
+    });
+    return shadow_map;
+}
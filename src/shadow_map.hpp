@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+#include "camera.hpp"
+#include "mesh.hpp"
+#include "vector_space.hpp"
+
+struct Vertices;
+
+// Disparities of the surfaces closest to a point light, rendered into the
+// six faces of a cube map around it.
+struct ShadowMap
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Matrix4d image_from_world[NUM_CUBE_FACES];
+    Vector4d depth_from_world[NUM_CUBE_FACES];
+    Vector4d light_position_world;
+    size_t resolution = 0;
+    std::vector<float> disparities;
+    bool empty() const { return disparities.empty(); }
+    // Returns 1 if the light reaches the position and a smaller fraction
+    // of it if the position is in shadow.
+    double lightFraction(const Vector4d& position_world) const;
+};
+
+// Renders the full level of the shapes with a depth-only shader.
+ShadowMap renderShadowMap(const Vertices& vertices, const Triangles& triangles, const Shapes& shapes,
+    const Vector4d& light_position_world, size_t resolution);
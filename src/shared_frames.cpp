@@ -0,0 +1,384 @@
+#include "shared_frames.hpp"
+
+#ifndef _WIN32
+
+#include <atomic>
+#include <cerrno>
+#include <ctime>
+#include <new>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+const uint32_t MAGIC = 0x46524D53;
+const size_t MAX_SLOTS = 16;
+const size_t ALIGNMENT = 64;
+// How long to wait for another writer to finish creating the memory.
+const int START_ATTEMPTS = 100;
+const useconds_t START_RETRY_MICROSECONDS = 10000;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The atomics must work across processes");
+
+// The sequence number is odd while the slot is being written.
+struct Slot
+{
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> number;
+    std::atomic<uint32_t> width;
+    std::atomic<uint32_t> height;
+};
+
+// The start of the shared memory, followed by the colors and then the
+// disparities of each slot.
+struct Header
+{
+    std::atomic<uint32_t> magic;
+    uint32_t num_slots;
+    uint32_t max_width;
+    uint32_t max_height;
+    uint64_t slot_size;
+    uint64_t disparities_offset;
+    int64_t writer_pid;
+    pthread_mutex_t mutex;
+    pthread_cond_t frame_ready;
+    std::atomic<uint64_t> num_published;
+    Slot slots[MAX_SLOTS];
+};
+
+size_t roundUp(size_t size)
+{
+    return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+size_t dataOffset()
+{
+    return roundUp(sizeof(Header));
+}
+
+Header& header(void* data)
+{
+    return *static_cast<Header*>(data);
+}
+
+char* slotData(void* data, size_t slot_size, size_t slot)
+{
+    return static_cast<char*>(data) + dataOffset() + slot * slot_size;
+}
+
+// The header comes from another process, so the slots have to fit in the
+// memory and the frames in the slots before they are used.
+bool isValid(const Header& h, size_t size)
+{
+    if (h.num_slots < 1 || h.num_slots > MAX_SLOTS)
+        return false;
+    const auto num_pixels = uint64_t{h.max_width} * h.max_height;
+    if (h.disparities_offset % sizeof(double) != 0 || h.disparities_offset > h.slot_size)
+        return false;
+    if (num_pixels > h.disparities_offset / sizeof(Pixel) ||
+        num_pixels > (h.slot_size - h.disparities_offset) / sizeof(double))
+        return false;
+    return h.slot_size <= (size - dataOffset()) / h.num_slots;
+}
+
+enum class WriterState
+{
+    NONE,
+    STARTING,
+    ALIVE,
+    DEAD,
+};
+
+// A writer is starting until it has sized the memory and written the magic
+// number, and dead once its process has exited.
+WriterState writerState(const std::string& name)
+{
+    const auto file = shm_open(name.c_str(), O_RDONLY, 0);
+    if (file < 0)
+        return errno == ENOENT ? WriterState::NONE : WriterState::ALIVE;
+    auto state = WriterState::STARTING;
+    struct stat status;
+    if (fstat(file, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(Header))
+    {
+        const auto data = mmap(nullptr, sizeof(Header), PROT_READ, MAP_SHARED, file, 0);
+        if (data != MAP_FAILED)
+        {
+            const auto& h = *static_cast<const Header*>(data);
+            if (h.magic.load(std::memory_order_acquire) == MAGIC)
+            {
+                const auto pid = static_cast<pid_t>(h.writer_pid);
+                const auto is_alive = kill(pid, 0) == 0 || errno == EPERM;
+                state = is_alive ? WriterState::ALIVE : WriterState::DEAD;
+            }
+            munmap(data, sizeof(Header));
+        }
+    }
+    close(file);
+    return state;
+}
+
+// Waits for a starting writer, so it is not mistaken for a dead one.
+WriterState waitForWriterState(const std::string& name)
+{
+    auto state = writerState(name);
+    for (int attempt = 1; attempt < START_ATTEMPTS && state == WriterState::STARTING; ++attempt)
+    {
+        usleep(START_RETRY_MICROSECONDS);
+        state = writerState(name);
+    }
+    return state;
+}
+
+// Locks the mutex and makes it consistent if its owner died while holding
+// it. It only guards num_published, which is atomic, so nothing needs to be
+// repaired.
+void lockMutex(pthread_mutex_t& mutex)
+{
+    if (pthread_mutex_lock(&mutex) == EOWNERDEAD)
+        pthread_mutex_consistent(&mutex);
+}
+
+} // namespace
+
+SharedFrameWriter::SharedFrameWriter(const std::string& name, size_t num_slots, size_t max_width, size_t max_height)
+    : name_(name)
+    , data_(nullptr)
+    , size_(0)
+    , num_published_(0)
+{
+    if (num_slots < 2 || num_slots > MAX_SLOTS)
+        return;
+    const auto num_pixels = max_width * max_height;
+    const auto disparities_offset = roundUp(num_pixels * sizeof(Pixel));
+    const auto slot_size = roundUp(disparities_offset + num_pixels * sizeof(double));
+    const auto size = dataOffset() + num_slots * slot_size;
+
+    auto file = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    // Replaces the memory of a writer that did not exit cleanly, but not
+    // of one that is still running or still creating it.
+    if (file < 0 && errno == EEXIST)
+    {
+        const auto state = waitForWriterState(name);
+        if (state == WriterState::DEAD)
+            shm_unlink(name.c_str());
+        if (state == WriterState::DEAD || state == WriterState::NONE)
+            file = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+    if (file < 0)
+        return;
+    if (ftruncate(file, static_cast<off_t>(size)) == 0)
+    {
+        const auto data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if (data != MAP_FAILED)
+        {
+            data_ = data;
+            size_ = size;
+        }
+    }
+    close(file);
+    if (!data_)
+    {
+        shm_unlink(name.c_str());
+        return;
+    }
+
+    auto& h = *new (data_) Header{};
+    h.num_slots = static_cast<uint32_t>(num_slots);
+    h.max_width = static_cast<uint32_t>(max_width);
+    h.max_height = static_cast<uint32_t>(max_height);
+    h.slot_size = slot_size;
+    h.disparities_offset = disparities_offset;
+    h.writer_pid = getpid();
+    // Robust, so readers can still lock it if the writer is killed while
+    // it holds it.
+    auto mutex_attributes = pthread_mutexattr_t{};
+    pthread_mutexattr_init(&mutex_attributes);
+    pthread_mutexattr_setpshared(&mutex_attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mutex_attributes, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&h.mutex, &mutex_attributes);
+    pthread_mutexattr_destroy(&mutex_attributes);
+    auto condition_attributes = pthread_condattr_t{};
+    pthread_condattr_init(&condition_attributes);
+    pthread_condattr_setpshared(&condition_attributes, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&h.frame_ready, &condition_attributes);
+    pthread_condattr_destroy(&condition_attributes);
+    // Readers only use the memory once they see the magic number.
+    h.magic.store(MAGIC, std::memory_order_release);
+}
+
+SharedFrameWriter::~SharedFrameWriter()
+{
+    if (!data_)
+        return;
+    munmap(data_, size_);
+    shm_unlink(name_.c_str());
+}
+
+bool SharedFrameWriter::beginFrame(Pixels& pixels, size_t width, size_t height)
+{
+    if (!data_)
+        return false;
+    auto& h = header(data_);
+    if (width > h.max_width || height > h.max_height)
+        return false;
+    const auto index = num_published_ % h.num_slots;
+    auto& slot = h.slots[index];
+    const auto sequence = slot.sequence.load(std::memory_order_relaxed);
+    if (sequence % 2 == 0)
+    {
+        slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    slot.number.store(num_published_, std::memory_order_relaxed);
+    slot.width.store(static_cast<uint32_t>(width), std::memory_order_relaxed);
+    slot.height.store(static_cast<uint32_t>(height), std::memory_order_relaxed);
+
+    const auto data = slotData(data_, h.slot_size, index);
+    pixels.colors.setExternal(reinterpret_cast<Pixel*>(data));
+    pixels.disparities.setExternal(reinterpret_cast<double*>(data + h.disparities_offset));
+    pixels.resize(width, height);
+    return true;
+}
+
+void SharedFrameWriter::publishFrame()
+{
+    auto& h = header(data_);
+    auto& slot = h.slots[num_published_ % h.num_slots];
+    slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    ++num_published_;
+    lockMutex(h.mutex);
+    h.num_published.store(num_published_, std::memory_order_release);
+    pthread_cond_broadcast(&h.frame_ready);
+    pthread_mutex_unlock(&h.mutex);
+}
+
+SharedFrameReader::SharedFrameReader(const std::string& name)
+    : data_(nullptr)
+    , size_(0)
+    , num_slots_(0)
+    , slot_size_(0)
+    , disparities_offset_(0)
+    , max_width_(0)
+    , max_height_(0)
+{
+    // The mutex and the condition variable are written when waiting.
+    const auto file = shm_open(name.c_str(), O_RDWR, 0);
+    if (file < 0)
+        return;
+    struct stat status;
+    if (fstat(file, &status) == 0 && static_cast<size_t>(status.st_size) >= dataOffset())
+    {
+        const auto size = static_cast<size_t>(status.st_size);
+        const auto data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if (data != MAP_FAILED)
+        {
+            data_ = data;
+            size_ = size;
+        }
+    }
+    close(file);
+    if (!data_)
+        return;
+    const auto& h = header(data_);
+    if (h.magic.load(std::memory_order_acquire) != MAGIC || !isValid(h, size_))
+    {
+        munmap(data_, size_);
+        data_ = nullptr;
+        return;
+    }
+    // Copied, so the writer cannot change the layout after it was checked.
+    num_slots_ = h.num_slots;
+    slot_size_ = h.slot_size;
+    disparities_offset_ = h.disparities_offset;
+    max_width_ = h.max_width;
+    max_height_ = h.max_height;
+}
+
+SharedFrameReader::~SharedFrameReader()
+{
+    if (data_) munmap(data_, size_);
+}
+
+size_t SharedFrameReader::numSlots() const
+{
+    return num_slots_;
+}
+
+uint64_t SharedFrameReader::waitForFrames(uint64_t num_seen, int timeout_milliseconds) const
+{
+    auto& h = header(data_);
+    auto deadline = timespec{};
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_milliseconds / 1000;
+    deadline.tv_nsec += (timeout_milliseconds % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    lockMutex(h.mutex);
+    while (h.num_published.load(std::memory_order_acquire) <= num_seen)
+    {
+        const auto result = pthread_cond_timedwait(&h.frame_ready, &h.mutex, &deadline);
+        if (result == EOWNERDEAD)
+            pthread_mutex_consistent(&h.mutex);
+        else if (result != 0)
+            break;
+    }
+    const auto num_published = h.num_published.load(std::memory_order_acquire);
+    pthread_mutex_unlock(&h.mutex);
+    return num_published;
+}
+
+bool SharedFrameReader::beginRead(uint64_t number, SharedFrame& frame) const
+{
+    auto& h = header(data_);
+    const auto index = number % num_slots_;
+    const auto& slot = h.slots[index];
+    const auto sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence % 2 == 1 || slot.number.load(std::memory_order_relaxed) != number ||
+        number >= h.num_published.load(std::memory_order_acquire))
+        return false;
+    const auto width = slot.width.load(std::memory_order_relaxed);
+    const auto height = slot.height.load(std::memory_order_relaxed);
+    if (width > max_width_ || height > max_height_)
+        return false;
+    const auto data = slotData(data_, slot_size_, index);
+    frame.number = number;
+    frame.sequence = sequence;
+    frame.width = width;
+    frame.height = height;
+    frame.colors = reinterpret_cast<const Pixel*>(data);
+    frame.disparities = reinterpret_cast<const double*>(data + disparities_offset_);
+    return true;
+}
+
+bool SharedFrameReader::endRead(const SharedFrame& frame) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return header(data_).slots[frame.number % num_slots_].sequence.load(std::memory_order_relaxed) == frame.sequence;
+}
+
+#else
+
+SharedFrameWriter::SharedFrameWriter(const std::string& name, size_t, size_t, size_t)
+    : name_(name), data_(nullptr), size_(0), num_published_(0) {}
+SharedFrameWriter::~SharedFrameWriter() {}
+bool SharedFrameWriter::beginFrame(Pixels&, size_t, size_t) { return false; }
+void SharedFrameWriter::publishFrame() {}
+
+SharedFrameReader::SharedFrameReader(const std::string&)
+    : data_(nullptr), size_(0), num_slots_(0), slot_size_(0), disparities_offset_(0), max_width_(0), max_height_(0) {}
+SharedFrameReader::~SharedFrameReader() {}
+size_t SharedFrameReader::numSlots() const { return 0; }
+uint64_t SharedFrameReader::waitForFrames(uint64_t, int) const { return 0; }
+bool SharedFrameReader::beginRead(uint64_t, SharedFrame&) const { return false; }
+bool SharedFrameReader::endRead(const SharedFrame&) const { return false; }
+
+#endif
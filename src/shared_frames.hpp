@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "drawing.hpp"
+
+// A ring of frames in POSIX shared memory, which a renderer draws into and
+// other processes read without copying. Each slot holds the colors and the
+// disparities of a frame of at most max_width x max_height pixels.
+//
+// The renderer never waits for readers. A slot is overwritten num_slots
+// frames after it was published, and its sequence number tells readers if
+// that happened while they read it. Not supported on Windows.
+class SharedFrameWriter
+{
+public:
+    // Creates the shared memory object with the name, which starts with /.
+    // Fails if another writer that is still running has the name, after
+    // waiting up to a second for one that is creating it.
+    SharedFrameWriter(const std::string& name, size_t num_slots, size_t max_width, size_t max_height);
+    // Unlinks the shared memory object. Readers keep their mapping.
+    ~SharedFrameWriter();
+    SharedFrameWriter(const SharedFrameWriter&) = delete;
+    SharedFrameWriter& operator=(const SharedFrameWriter&) = delete;
+    bool isOpen() const { return data_ != nullptr; }
+    // Points the pixels at the next slot and resizes them, so the frame is
+    // drawn straight into shared memory. Returns false if the frame is
+    // larger than the slots.
+    bool beginFrame(Pixels& pixels, size_t width, size_t height);
+    // Publishes the frame of the last beginFrame and wakes up the readers.
+    // The pixels stay pointed at the slot until the next beginFrame.
+    void publishFrame();
+    uint64_t numPublished() const { return num_published_; }
+private:
+    std::string name_;
+    void* data_;
+    size_t size_;
+    uint64_t num_published_;
+};
+
+// A published frame, valid until it is overwritten.
+struct SharedFrame
+{
+    uint64_t number = 0;
+    uint64_t sequence = 0;
+    size_t width = 0;
+    size_t height = 0;
+    const Pixel* colors = nullptr;
+    const double* disparities = nullptr;
+};
+
+class SharedFrameReader
+{
+public:
+    // Opens the shared memory object of a SharedFrameWriter with the name.
+    // Fails if its header describes slots that do not fit in it.
+    explicit SharedFrameReader(const std::string& name);
+    ~SharedFrameReader();
+    SharedFrameReader(const SharedFrameReader&) = delete;
+    SharedFrameReader& operator=(const SharedFrameReader&) = delete;
+    bool isOpen() const { return data_ != nullptr; }
+    size_t numSlots() const;
+    // Waits until more than num_seen frames are published or the timeout
+    // passes, and returns the number of published frames.
+    uint64_t waitForFrames(uint64_t num_seen, int timeout_milliseconds) const;
+    // Points the frame at frame number, counted from 0, and returns false
+    // if its slot is being written, holds another frame or is larger than
+    // the slots.
+    bool beginRead(uint64_t number, SharedFrame& frame) const;
+    // Returns false if the frame was overwritten since beginRead, in which
+    // case what was read from it may be torn.
+    bool endRead(const SharedFrame& frame) const;
+private:
+    void* data_;
+    size_t size_;
+    size_t num_slots_;
+    size_t slot_size_;
+    size_t disparities_offset_;
+    size_t max_width_;
+    size_t max_height_;
+};
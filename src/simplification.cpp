@@ -0,0 +1,335 @@
+#include "simplification.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include "parallel.hpp"
+
+namespace
+{
+
+const size_t MIN_LOD_TRIANGLES = 16;
+// A level is only kept if it has at most this fraction of the triangles of
+// the previous level.
+const double MAX_LOD_FRACTION = 0.75;
+// Collapses that turn a triangle more than this are rejected.
+const double MIN_NORMAL_COSINE = 0.2;
+// Collapses that make a sliver triangle are rejected, since the rasterizer
+// visits the whole bounding box of a triangle. The quality is 1 for an
+// equilateral triangle and 0 for a degenerate one.
+const double MIN_TRIANGLE_QUALITY = 0.25;
+
+using Quadric = Eigen::Matrix4d;
+using Quadrics = std::vector<Quadric, Eigen::aligned_allocator<Quadric>>;
+using Triangle = std::array<size_t, 3>;
+
+struct Collapse
+{
+    double cost;
+    size_t from;
+    size_t to;
+    size_t from_version;
+    size_t to_version;
+    bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+struct EdgeUse
+{
+    int count;
+    size_t texture_index;
+    bool texture_seam;
+};
+
+struct Level
+{
+    std::vector<Triangle> triangles;
+    std::vector<size_t> texture_indices;
+    double error;
+};
+
+// Half-edge collapse simplification of one shape, using local vertex indices.
+class Simplifier
+{
+public:
+    Simplifier(const Vectors4d& positions_world, const Triangles& triangles, size_t begin, size_t end);
+    size_t numTriangles() const { return num_alive; }
+    void simplify(size_t target_triangles);
+    Level level() const;
+private:
+    Eigen::Vector3d normal(const Triangle& triangle) const;
+    bool contains(const Triangle& triangle, size_t vertex) const;
+    double quality(const Triangle& triangle) const;
+    bool isInvalidCollapse(size_t from, size_t to) const;
+    void collapse(size_t from, size_t to);
+    void pushCollapse(size_t from, size_t to);
+
+    std::vector<size_t> global_vertices;
+    Vectors4d positions;
+    Quadrics quadrics;
+    std::vector<bool> locked;
+    std::vector<bool> removed;
+    std::vector<size_t> versions;
+    std::vector<std::vector<size_t>> vertex_triangles;
+    std::vector<Triangle> triangles;
+    std::vector<size_t> texture_indices;
+    std::vector<bool> triangle_removed;
+    size_t num_alive;
+    double max_cost;
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> collapses;
+};
+
+Simplifier::Simplifier(const Vectors4d& positions_world, const Triangles& all_triangles, size_t begin, size_t end)
+    : num_alive(end - begin)
+    , max_cost(0.0)
+{
+    auto local_vertices = std::unordered_map<size_t, size_t>{};
+    const auto local = [&](size_t global)
+    {
+        const auto inserted = local_vertices.emplace(global, global_vertices.size());
+        if (inserted.second)
+        {
+            global_vertices.push_back(global);
+            positions.push_back(positions_world[global]);
+            positions.back()(3) = 1.0;
+        }
+        return inserted.first->second;
+    };
+    for (auto i = begin; i < end; ++i)
+    {
+        triangles.push_back({
+            local(all_triangles.indices0[i]),
+            local(all_triangles.indices1[i]),
+            local(all_triangles.indices2[i]) });
+        texture_indices.push_back(all_triangles.texture_indices[i]);
+    }
+
+    const auto num_vertices = global_vertices.size();
+    quadrics = Quadrics(num_vertices, Quadric::Zero());
+    locked = std::vector<bool>(num_vertices, false);
+    removed = std::vector<bool>(num_vertices, false);
+    versions = std::vector<size_t>(num_vertices, 0);
+    vertex_triangles = std::vector<std::vector<size_t>>(num_vertices);
+    triangle_removed = std::vector<bool>(triangles.size(), false);
+
+    // Vertices on edges that are not shared by exactly two triangles of the
+    // same texture are locked.
+    auto edges = std::map<std::pair<size_t, size_t>, EdgeUse>{};
+    for (size_t t = 0; t < triangles.size(); ++t)
+    {
+        const auto& triangle = triangles[t];
+        const auto n = normal(triangle);
+        const auto length = n.norm();
+        if (length > 0.0)
+        {
+            const auto unit = Eigen::Vector3d{ n / length };
+            const auto plane = Vector4d{ unit(0), unit(1), unit(2), -unit.dot(positions[triangle[0]].head<3>()) };
+            const auto quadric = Quadric{ plane * plane.transpose() };
+            for (const auto v : triangle)
+                quadrics[v] += quadric;
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            const auto a = triangle[k];
+            const auto b = triangle[(k + 1) % 3];
+            auto& edge = edges[std::minmax(a, b)];
+            if (edge.count == 0)
+                edge.texture_index = texture_indices[t];
+            else if (edge.texture_index != texture_indices[t])
+                edge.texture_seam = true;
+            edge.count += 1;
+            vertex_triangles[a].push_back(t);
+        }
+    }
+    for (const auto& edge : edges)
+    {
+        if (edge.second.count != 2 || edge.second.texture_seam)
+        {
+            locked[edge.first.first] = true;
+            locked[edge.first.second] = true;
+        }
+    }
+    for (const auto& triangle : triangles)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            pushCollapse(triangle[k], triangle[(k + 1) % 3]);
+            pushCollapse(triangle[(k + 1) % 3], triangle[k]);
+        }
+    }
+}
+
+Eigen::Vector3d Simplifier::normal(const Triangle& triangle) const
+{
+    const auto a = Eigen::Vector3d{ positions[triangle[0]].head<3>() };
+    const auto b = Eigen::Vector3d{ positions[triangle[1]].head<3>() };
+    const auto c = Eigen::Vector3d{ positions[triangle[2]].head<3>() };
+    return (b - a).cross(c - a);
+}
+
+bool Simplifier::contains(const Triangle& triangle, size_t vertex) const
+{
+    return triangle[0] == vertex || triangle[1] == vertex || triangle[2] == vertex;
+}
+
+double Simplifier::quality(const Triangle& triangle) const
+{
+    const auto a = Eigen::Vector3d{ positions[triangle[0]].head<3>() };
+    const auto b = Eigen::Vector3d{ positions[triangle[1]].head<3>() };
+    const auto c = Eigen::Vector3d{ positions[triangle[2]].head<3>() };
+    const auto edge_lengths = (b - a).squaredNorm() + (c - b).squaredNorm() + (a - c).squaredNorm();
+    if (edge_lengths <= 0.0) return 0.0;
+    return 2.0 * std::sqrt(3.0) * normal(triangle).norm() / edge_lengths;
+}
+
+bool Simplifier::isInvalidCollapse(size_t from, size_t to) const
+{
+    for (const auto t : vertex_triangles[from])
+    {
+        if (triangle_removed[t] || contains(triangles[t], to))
+            continue;
+        auto moved = triangles[t];
+        std::replace(moved.begin(), moved.end(), from, to);
+        const auto normal_before = normal(triangles[t]);
+        const auto normal_after = normal(moved);
+        const auto lengths = normal_before.norm() * normal_after.norm();
+        if (lengths <= 0.0 || normal_before.dot(normal_after) < MIN_NORMAL_COSINE * lengths)
+            return true;
+        if (quality(moved) < std::min(MIN_TRIANGLE_QUALITY, quality(triangles[t])))
+            return true;
+    }
+    return false;
+}
+
+void Simplifier::collapse(size_t from, size_t to)
+{
+    quadrics[to] += quadrics[from];
+    for (const auto t : vertex_triangles[from])
+    {
+        if (triangle_removed[t])
+            continue;
+        if (contains(triangles[t], to))
+        {
+            triangle_removed[t] = true;
+            --num_alive;
+            continue;
+        }
+        std::replace(triangles[t].begin(), triangles[t].end(), from, to);
+        vertex_triangles[to].push_back(t);
+    }
+    removed[from] = true;
+    vertex_triangles[from].clear();
+    ++versions[to];
+
+    auto& neighbours = vertex_triangles[to];
+    neighbours.erase(std::remove_if(neighbours.begin(), neighbours.end(),
+        [&](size_t t) { return triangle_removed[t]; }), neighbours.end());
+    for (const auto t : neighbours)
+    {
+        for (const auto v : triangles[t])
+        {
+            if (v == to) continue;
+            pushCollapse(to, v);
+            pushCollapse(v, to);
+        }
+    }
+}
+
+void Simplifier::pushCollapse(size_t from, size_t to)
+{
+    if (locked[from])
+        return;
+    const auto& p = positions[to];
+    const auto cost = std::max(0.0, p.dot((quadrics[from] + quadrics[to]) * p));
+    collapses.push({ cost, from, to, versions[from], versions[to] });
+}
+
+void Simplifier::simplify(size_t target_triangles)
+{
+    while (num_alive > target_triangles && !collapses.empty())
+    {
+        const auto c = collapses.top();
+        collapses.pop();
+        if (removed[c.from] || removed[c.to]) continue;
+        if (versions[c.from] != c.from_version || versions[c.to] != c.to_version) continue;
+        if (isInvalidCollapse(c.from, c.to)) continue;
+        collapse(c.from, c.to);
+        max_cost = std::max(max_cost, c.cost);
+    }
+}
+
+Level Simplifier::level() const
+{
+    auto result = Level{};
+    for (size_t t = 0; t < triangles.size(); ++t)
+    {
+        if (triangle_removed[t]) continue;
+        const auto& triangle = triangles[t];
+        result.triangles.push_back({
+            global_vertices[triangle[0]],
+            global_vertices[triangle[1]],
+            global_vertices[triangle[2]] });
+        result.texture_indices.push_back(texture_indices[t]);
+    }
+    // The quadric error is a sum of squared distances to the original planes.
+    result.error = std::sqrt(max_cost);
+    return result;
+}
+
+} // namespace
+
+void makeLods(const Vectors4d& positions_world, Triangles& triangles, Shapes& shapes, size_t max_lods)
+{
+    const auto num_shapes = shapes.size();
+    auto levels = std::vector<std::vector<Level>>(num_shapes);
+
+    parallelFor(num_shapes, [&](size_t s)
+    {
+        auto simplifier = Simplifier(positions_world, triangles, shapes.triangle_begins[s], shapes.triangle_ends[s]);
+        auto num_triangles = simplifier.numTriangles();
+        while (levels[s].size() + 1 < max_lods && num_triangles >= MIN_LOD_TRIANGLES)
+        {
+            simplifier.simplify(num_triangles / 2);
+            if (simplifier.numTriangles() > MAX_LOD_FRACTION * num_triangles)
+                break;
+            num_triangles = simplifier.numTriangles();
+            levels[s].push_back(simplifier.level());
+        }
+    });
+
+    shapes.lod_begins.clear();
+    shapes.lod_ends.clear();
+    shapes.lod_triangle_begins.clear();
+    shapes.lod_triangle_ends.clear();
+    shapes.lod_errors.clear();
+
+    for (size_t s = 0; s < num_shapes; ++s)
+    {
+        shapes.lod_begins.push_back(shapes.lod_errors.size());
+        shapes.lod_triangle_begins.push_back(shapes.triangle_begins[s]);
+        shapes.lod_triangle_ends.push_back(shapes.triangle_ends[s]);
+        shapes.lod_errors.push_back(0.0);
+        for (const auto& level : levels[s])
+        {
+            shapes.lod_triangle_begins.push_back(triangles.size());
+            for (size_t t = 0; t < level.triangles.size(); ++t)
+            {
+                triangles.indices0.push_back(level.triangles[t][0]);
+                triangles.indices1.push_back(level.triangles[t][1]);
+                triangles.indices2.push_back(level.triangles[t][2]);
+                triangles.texture_indices.push_back(level.texture_indices[t]);
+            }
+            shapes.lod_triangle_ends.push_back(triangles.size());
+            shapes.lod_errors.push_back(level.error);
+        }
+        shapes.lod_ends.push_back(shapes.lod_errors.size());
+    }
+}
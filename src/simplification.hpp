@@ -0,0 +1,13 @@
+#pragma once
+
+#include "mesh.hpp"
+#include "vector_space.hpp"
+
+// Appends up to max_lods - 1 simplified levels of each shape to the
+// triangles and fills the lod table of the shapes. Each level has about
+// half the triangles of the previous one. Edges are collapsed into one of
+// their vertices, chosen by the quadric error metric, so all levels reuse
+// the vertices of the full shape. Vertices on the border of a shape or on
+// a texture seam are never removed, so neighbouring shapes at different
+// levels still meet without cracks.
+void makeLods(const Vectors4d& positions_world, Triangles& triangles, Shapes& shapes, size_t max_lods);
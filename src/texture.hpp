@@ -18,6 +18,9 @@ public:
     {}
     bool  empty() const { return size() == 0; }
     size_t size() const { return width_ * height_; }
+    size_t width() const { return width_; }
+    size_t height() const { return height_; }
+    const Vectors4d& colors() const { return colors_; }
     Vector4d&        operator[](size_t i)       { return colors_[i]; }
     const Vector4d&  operator[](size_t i) const { return colors_[i]; }
 
@@ -25,8 +28,8 @@ public:
     {
         while (x < 0.0) x += 1.0;
         while (y < 0.0) y += 1.0;
-        while (1.0 < x) x -= 1.0;
-        while (1.0 < y) y -= 1.0;
+        while (1.0 <= x) x -= 1.0;
+        while (1.0 <= y) y -= 1.0;
 
         const auto xi = static_cast<size_t>(x * width_);
         const auto yi = static_cast<size_t>(y * height_);
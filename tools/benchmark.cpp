@@ -0,0 +1,221 @@
+// Renders a model headless along a recorded camera path and reports the
+// percentiles of the frame and stage times, as text and optionally as JSON
+// for comparing commits. The path is repeated if it has fewer frames.
+// Usage: benchmark model.obj camera_path.txt [width] [height] [frames] [output.json]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "camera.hpp"
+#include "camera_path.hpp"
+#include "counters.hpp"
+#include "drawing.hpp"
+#include "lightmap.hpp"
+#include "mesh.hpp"
+#include "pvs.hpp"
+#include "shadow_map.hpp"
+
+struct Stage
+{
+    std::string name;
+    std::vector<double> milliseconds;
+};
+
+// The nearest rank percentile of the sorted values.
+double percentile(const std::vector<double>& sorted, double p)
+{
+    const auto rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+std::string jsonString(const std::string& text)
+{
+    auto quoted = std::string("\"");
+    for (const auto c : text)
+    {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+double totalSeconds(const std::vector<double>& milliseconds)
+{
+    auto seconds = 0.0;
+    for (const auto m : milliseconds)
+        seconds += m / 1000.0;
+    return seconds;
+}
+
+void writeJson(std::ostream& stream, const std::string& model, const std::string& camera_path,
+    int width, int height, size_t num_triangles, double setup_milliseconds, const std::vector<Stage>& stages,
+    const PipelineCounters& counters)
+{
+    const auto& frame = stages.back().milliseconds;
+    const auto num_frames = frame.size();
+    const auto total_seconds = totalSeconds(frame);
+
+    stream << "{\n";
+    stream << "  \"model\": " << jsonString(model) << ",\n";
+    stream << "  \"camera_path\": " << jsonString(camera_path) << ",\n";
+    stream << "  \"width\": " << width << ",\n";
+    stream << "  \"height\": " << height << ",\n";
+    stream << "  \"frames\": " << num_frames << ",\n";
+    stream << "  \"triangles\": " << num_triangles << ",\n";
+    stream << "  \"setup_ms\": " << setup_milliseconds << ",\n";
+    stream << "  \"triangles_per_second\": " << num_triangles * num_frames / total_seconds << ",\n";
+    stream << "  \"pixels_per_second\": " << double(width) * height * num_frames / total_seconds << ",\n";
+    stream << "  \"stages\": {\n";
+    for (size_t i = 0; i < stages.size(); ++i)
+    {
+        auto sorted = stages[i].milliseconds;
+        std::sort(sorted.begin(), sorted.end());
+        auto sum = 0.0;
+        for (const auto milliseconds : sorted)
+            sum += milliseconds;
+        stream << "    \"" << stages[i].name << "\": {"
+               << "\"mean_ms\": " << sum / sorted.size()
+               << ", \"min_ms\": " << sorted.front()
+               << ", \"p50_ms\": " << percentile(sorted, 50.0)
+               << ", \"p95_ms\": " << percentile(sorted, 95.0)
+               << ", \"p99_ms\": " << percentile(sorted, 99.0)
+               << ", \"max_ms\": " << sorted.back()
+               << "}" << (i + 1 < stages.size() ? "," : "") << "\n";
+    }
+    stream << "  },\n";
+    if (PIPELINE_COUNTERS_ENABLED)
+    {
+        const auto& c = counters;
+        stream << "  \"counters_per_frame\": {"
+               << "\"vertices\": " << double(c.vertices) / num_frames
+               << ", \"triangles_in\": " << double(c.triangles_in) / num_frames
+               << ", \"triangles_outside_frustum\": " << double(c.triangles_outside_frustum) / num_frames
+               << ", \"triangles_behind_camera\": " << double(c.triangles_behind_camera) / num_frames
+               << ", \"triangles_off_screen\": " << double(c.triangles_off_screen) / num_frames
+               << ", \"triangles_zero_area\": " << double(c.triangles_zero_area) / num_frames
+               << ", \"pixels_tested\": " << double(c.pixels_tested) / num_frames
+               << ", \"pixels_covered\": " << double(c.pixels_covered) / num_frames
+               << ", \"depth_test_passes\": " << double(c.depth_test_passes) / num_frames
+               << ", \"depth_test_failures\": " << double(c.depth_test_failures) / num_frames
+               << ", \"shader_invocations\": " << double(c.shader_invocations) / num_frames
+               << ", \"overdraw\": " << c.overdraw()
+               << "},\n";
+    }
+    stream << "  \"frame_ms\": [";
+    for (size_t i = 0; i < num_frames; ++i)
+        stream << (i ? ", " : "") << frame[i];
+    stream << "]\n";
+    stream << "}\n";
+}
+
+int main(int argc, char** argv)
+{
+    using namespace std;
+    using namespace std::chrono;
+    if (argc < 3)
+    {
+        cerr << "Usage: benchmark model.obj camera_path.txt [width] [height] [frames] [output.json]" << endl;
+        return 1;
+    }
+    const auto filepath = string(argv[1]);
+    const auto camera_path_filepath = string(argv[2]);
+    const auto width = argc > 3 ? atoi(argv[3]) : 800;
+    const auto height = argc > 4 ? atoi(argv[4]) : 600;
+    auto camera_path = vector<CameraExtrinsics>{};
+    if (!loadCameraPath(camera_path_filepath, camera_path) || camera_path.empty())
+    {
+        cerr << "Could not read camera path " << camera_path_filepath << endl;
+        return 1;
+    }
+    const auto num_frames = argc > 5 ? size_t(atoi(argv[5])) : camera_path.size();
+    if (num_frames == 0)
+    {
+        cerr << "No frames to render" << endl;
+        return 1;
+    }
+    const auto json_filepath = argc > 6 ? string(argv[6]) : string();
+    const auto shadow_map_resolution = 512;
+
+    auto positions_world = Vectors4d{};
+    auto positions_texture = Vectors2d{};
+    auto triangles = Triangles{};
+    auto shapes = Shapes{};
+    auto textures = Textures{};
+    loadModel(filepath, positions_world, positions_texture, triangles, shapes, textures);
+    auto potentially_visible_sets = PotentiallyVisibleSets{};
+    const auto pvs_filepath = stripFileExtension(filepath) + ".pvs";
+    loadPotentiallyVisibleSets(pvs_filepath, hashMesh(positions_world, triangles, shapes), potentially_visible_sets);
+
+    auto vertices = Vertices(positions_world.size());
+    vertices.positions_world = positions_world;
+    vertices.positions_texture = positions_texture;
+
+    auto environment = Environment{ makeCameraIntrinsics(width, height), CameraExtrinsics{}, makeLight() };
+    const auto setup_start = steady_clock::now();
+    const auto shadow_map = renderShadowMap(vertices, triangles, shapes, environment.light.position_world, shadow_map_resolution);
+    const auto lightmaps = bakeLightmaps(vertices, triangles, environment.light.position_world, shadow_map);
+    const auto setup_milliseconds = duration<double, milli>(steady_clock::now() - setup_start).count();
+
+    auto stages = vector<Stage>{ {"vertex_shader", {}}, {"draw_triangles", {}}, {"frame", {}} };
+    auto pixels = Pixels(width, height);
+    const auto render = [&](size_t frame)
+    {
+        environment.extrinsics = camera_path[frame % camera_path.size()];
+        const auto start = steady_clock::now();
+        vertexShader(vertices, environment);
+        const auto vertices_done = steady_clock::now();
+        drawTriangles(pixels, vertices, triangles, shapes, textures,
+            potentially_visible_sets, lightmaps, shadow_map, environment);
+        const auto stop = steady_clock::now();
+        stages[0].milliseconds.push_back(duration<double, milli>(vertices_done - start).count());
+        stages[1].milliseconds.push_back(duration<double, milli>(stop - vertices_done).count());
+        stages[2].milliseconds.push_back(duration<double, milli>(stop - start).count());
+    };
+    // Warms up the caches and the allocations before measuring.
+    render(0);
+    for (auto& stage : stages)
+        stage.milliseconds.clear();
+    resetPipelineCounters();
+    for (size_t frame = 0; frame < num_frames; ++frame)
+        render(frame);
+
+    cout << endl;
+    cout << "model      : " << filepath << endl;
+    cout << "resolution : " << width << " x " << height << ", " << num_frames << " frames" << endl;
+    cout << "setup      : " << setup_milliseconds << " ms" << endl;
+    for (const auto& stage : stages)
+    {
+        auto sorted = stage.milliseconds;
+        sort(sorted.begin(), sorted.end());
+        cout << stage.name << string(16 - min<size_t>(stage.name.size(), 15), ' ')
+             << "p50 " << percentile(sorted, 50.0) << " ms, p95 " << percentile(sorted, 95.0)
+             << " ms, p99 " << percentile(sorted, 99.0) << " ms" << endl;
+    }
+    // Counts all triangles of the model, including culled ones.
+    const auto total_seconds = totalSeconds(stages.back().milliseconds);
+    cout << "triangles/s: " << triangles.size() * num_frames / total_seconds << endl;
+    cout << "pixels/s   : " << double(width) * height * num_frames / total_seconds << endl;
+    if (PIPELINE_COUNTERS_ENABLED)
+    {
+        cout << endl << "Counters of all frames:" << endl;
+        printPipelineCounters(cout, pipelineCounters());
+    }
+    if (!json_filepath.empty())
+    {
+        auto file = ofstream(json_filepath);
+        writeJson(file, filepath, camera_path_filepath, width, height, triangles.size(), setup_milliseconds, stages, pipelineCounters());
+        if (!file)
+        {
+            cerr << "Could not write " << json_filepath << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+// Builds the potentially visible sets of a static model and writes them
+// next to the model, where the renderer picks them up.
+// Usage: build_pvs model.obj [cell_size] [samples_per_cell] [resolution]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "mesh.hpp"
+#include "pvs.hpp"
+
+int main(int argc, char** argv)
+{
+    using namespace std;
+    using namespace std::chrono;
+    if (argc < 2)
+    {
+        cerr << "Usage: build_pvs model.obj [cell_size] [samples_per_cell] [resolution]" << endl;
+        return 1;
+    }
+    const auto filepath = string(argv[1]);
+    const auto cell_size = argc > 2 ? atof(argv[2]) : 2.0;
+    const auto samples_per_cell = argc > 3 ? size_t(atoi(argv[3])) : 4;
+    const auto resolution = argc > 4 ? size_t(atoi(argv[4])) : 128;
+
+    auto positions_world = Vectors4d{};
+    auto positions_texture = Vectors2d{};
+    auto triangles = Triangles{};
+    auto shapes = Shapes{};
+    auto textures = Textures{};
+    loadModel(filepath, positions_world, positions_texture, triangles, shapes, textures);
+
+    const auto start = steady_clock::now();
+    const auto potentially_visible_sets = buildPotentiallyVisibleSets(
+        positions_world, triangles, shapes, cell_size, samples_per_cell, resolution);
+    const auto seconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+    const auto num_cells = potentially_visible_sets.numCells();
+    const auto average_visible = double(potentially_visible_sets.shapes.size()) / num_cells;
+    cout << "# of cells     : " << num_cells << endl;
+    cout << "visible shapes : " << average_visible << " of " << shapes.size() << " on average" << endl;
+    cout << "built in " << seconds << " s" << endl;
+
+    const auto pvs_filepath = stripFileExtension(filepath) + ".pvs";
+    if (!savePotentiallyVisibleSets(pvs_filepath, potentially_visible_sets))
+    {
+        cerr << "Failed to write " << pvs_filepath << endl;
+        return 1;
+    }
+    cout << "Wrote " << pvs_filepath << endl;
+    return 0;
+}
@@ -0,0 +1,117 @@
+// Renders a camera path with all pixels and with checkerboard rendering,
+// and reports the draw time and the quality of the reconstructed frames.
+// Usage: checkerboard_quality model.obj [width] [height] [frames] [speed]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include "camera.hpp"
+#include "checkerboard.hpp"
+#include "drawing.hpp"
+#include "mesh.hpp"
+
+// Peak signal to noise ratio in decibel over the red, green and blue channels.
+double peakSignalToNoiseRatio(const Pixels& reference, const Pixels& pixels)
+{
+    auto squared_error = 0.0;
+    for (size_t i = 0; i < reference.size(); ++i)
+    {
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            const auto difference = double((reference.colors[i] >> shift) & 0xFF) - double((pixels.colors[i] >> shift) & 0xFF);
+            squared_error += difference * difference;
+        }
+    }
+    const auto mean_squared_error = squared_error / (3.0 * reference.size());
+    if (mean_squared_error == 0.0)
+        return std::numeric_limits<double>::infinity();
+    return 10.0 * std::log10(255.0 * 255.0 / mean_squared_error);
+}
+
+int main(int argc, char** argv)
+{
+    using namespace std;
+    using namespace std::chrono;
+    if (argc < 2)
+    {
+        cerr << "Usage: checkerboard_quality model.obj [width] [height] [frames] [speed]" << endl;
+        return 1;
+    }
+    const auto filepath = string(argv[1]);
+    const auto width = argc > 2 ? atoi(argv[2]) : 800;
+    const auto height = argc > 3 ? atoi(argv[3]) : 600;
+    const auto num_frames = argc > 4 ? atoi(argv[4]) : 100;
+    // Distance moved sideways per frame, with a turn of 0.01 radians.
+    const auto speed = argc > 5 ? atof(argv[5]) : 0.05;
+
+    auto positions_world = Vectors4d{};
+    auto positions_texture = Vectors2d{};
+    auto triangles = Triangles{};
+    auto shapes = Shapes{};
+    auto textures = Textures{};
+    loadModel(filepath, positions_world, positions_texture, triangles, shapes, textures);
+
+    auto vertices = Vertices(positions_world.size());
+    vertices.positions_world = positions_world;
+    vertices.positions_texture = positions_texture;
+
+    auto environment = Environment{ makeCameraIntrinsics(width, height), CameraExtrinsics{}, makeLight() };
+    auto reference = Pixels(width, height);
+    auto pixels = Pixels(width, height);
+    auto checkerboard = CheckerboardReconstruction{};
+    auto statistics = CheckerboardStatistics{};
+    auto full_milliseconds = 0.0;
+    auto checkerboard_milliseconds = 0.0;
+    auto total_psnr = 0.0;
+    auto min_psnr = numeric_limits<double>::infinity();
+    auto num_measured = 0;
+
+    for (int frame = 0; frame < num_frames; ++frame)
+    {
+        environment.extrinsics.x = speed * frame;
+        environment.extrinsics.yaw = 0.01 * frame;
+        vertexShader(vertices, environment);
+
+        auto start = steady_clock::now();
+        drawTriangles(reference, vertices, triangles, shapes, textures,
+            PotentiallyVisibleSets{}, Lightmaps{}, ShadowMap{}, environment);
+        full_milliseconds += duration<double, milli>(steady_clock::now() - start).count();
+
+        start = steady_clock::now();
+        auto options = DrawOptions{};
+        options.checkerboard_parity = checkerboard.parity();
+        drawTriangles(pixels, vertices, triangles, shapes, textures,
+            PotentiallyVisibleSets{}, Lightmaps{}, ShadowMap{}, environment, options);
+        const auto frame_statistics = checkerboard.reconstruct(pixels, environment);
+        checkerboard_milliseconds += duration<double, milli>(steady_clock::now() - start).count();
+
+        // The first frame has no history to reproject.
+        if (frame == 0)
+            continue;
+        statistics.num_reprojected += frame_statistics.num_reprojected;
+        statistics.num_interpolated += frame_statistics.num_interpolated;
+        const auto psnr = peakSignalToNoiseRatio(reference, pixels);
+        total_psnr += psnr;
+        min_psnr = min(min_psnr, psnr);
+        ++num_measured;
+    }
+
+    const auto num_reconstructed = double(statistics.num_reprojected + statistics.num_interpolated);
+    cout << endl;
+    cout << "resolution   : " << width << " x " << height << ", " << num_frames << " frames" << endl;
+    cout << "full         : " << full_milliseconds / num_frames << " ms per frame" << endl;
+    cout << "checkerboard : " << checkerboard_milliseconds / num_frames << " ms per frame" << endl;
+    cout << "speedup      : " << full_milliseconds / checkerboard_milliseconds << endl;
+    if (num_measured == 0)
+        return 0;
+    cout << "reprojected  : " << 100.0 * statistics.num_reprojected / num_reconstructed << " %" << endl;
+    cout << "interpolated : " << 100.0 * statistics.num_interpolated / num_reconstructed << " %" << endl;
+    cout << "psnr average : " << total_psnr / num_measured << " dB" << endl;
+    cout << "psnr minimum : " << min_psnr << " dB" << endl;
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Renders frames without a window, with the same shadow map, lightmap,
+// quantization, checkerboard and shading rate passes as the interactive
+// renderer and the same settings as main.cpp, but at a fixed resolution.
+// Writes the frames as PPM images or keeps them in memory.
+// An output prefix like shm:/rasterizer instead draws the frames straight
+// into a ring of shared memory with that name, for shared_frames_reader or
+// other processes to read. The camera turns a full circle from the origin
+// over the frames.
+// Usage: headless model.obj [width] [height] [frames] [output_prefix]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "camera.hpp"
+#include "checkerboard.hpp"
+#include "drawing.hpp"
+#include "lightmap.hpp"
+#include "mesh.hpp"
+#include "ppm.hpp"
+#include "pvs.hpp"
+#include "shading_rate.hpp"
+#include "shadow_map.hpp"
+#include "shared_frames.hpp"
+
+int main(int argc, char** argv)
+{
+    using namespace std;
+    using namespace std::chrono;
+    const auto width = argc > 2 ? atoi(argv[2]) : 800;
+    const auto height = argc > 3 ? atoi(argv[3]) : 600;
+    const auto num_frames = argc > 4 ? atoi(argv[4]) : 1;
+    if (argc < 2 || width < 1 || height < 1 || num_frames < 1)
+    {
+        cerr << "Usage: headless model.obj [width] [height] [frames] [output_prefix]" << endl;
+        cerr << "The width, height and frames must be at least 1" << endl;
+        return 1;
+    }
+    const auto filepath = string(argv[1]);
+    // Without a prefix the frames are kept in memory.
+    const auto output_prefix = argc > 5 ? string(argv[5]) : string();
+    const auto shared_memory_prefix = string("shm:");
+    const auto num_shared_slots = 3;
+    const auto shadow_map_resolution = 512;
+    // The settings of main.cpp.
+    const auto quantize_vertices = false;
+    const auto checkerboard_rendering = false;
+    const auto shading_rate_max_error = 0.0;
+    const auto pi = 3.14159265358979323846;
+
+    auto positions_world = Vectors4d{};
+    auto positions_texture = Vectors2d{};
+    auto triangles = Triangles{};
+    auto shapes = Shapes{};
+    auto textures = Textures{};
+    loadModel(filepath, positions_world, positions_texture, triangles, shapes, textures);
+    auto potentially_visible_sets = PotentiallyVisibleSets{};
+    const auto pvs_filepath = stripFileExtension(filepath) + ".pvs";
+    loadPotentiallyVisibleSets(pvs_filepath, hashMesh(positions_world, triangles, shapes), potentially_visible_sets);
+
+    auto vertices = Vertices(positions_world.size());
+    vertices.positions_world = positions_world;
+    vertices.positions_texture = positions_texture;
+    if (quantize_vertices)
+        quantizeVertices(vertices);
+
+    auto environment = Environment{ makeCameraIntrinsics(width, height), CameraExtrinsics{}, makeLight() };
+    auto checkerboard = CheckerboardReconstruction{};
+    auto shading_rates = ShadingRates{};
+    shading_rates.materials = makeMaterialShadingRates(textures);
+    const auto bake_start = steady_clock::now();
+    const auto shadow_map = renderShadowMap(vertices, triangles, shapes, environment.light.position_world, shadow_map_resolution);
+    const auto lightmaps = bakeLightmaps(vertices, triangles, environment.light.position_world, shadow_map);
+    cout << "Baked lightmaps in " << duration<double, milli>(steady_clock::now() - bake_start).count() << " ms" << endl;
+
+    auto shared_frames = unique_ptr<SharedFrameWriter>{};
+    if (output_prefix.compare(0, shared_memory_prefix.size(), shared_memory_prefix) == 0)
+    {
+        const auto name = output_prefix.substr(shared_memory_prefix.size());
+        shared_frames = make_unique<SharedFrameWriter>(name, num_shared_slots, width, height);
+        if (!shared_frames->isOpen())
+        {
+            cerr << "Could not create shared memory " << name << endl;
+            return 1;
+        }
+    }
+
+    auto frames = vector<Pixels>{};
+    auto pixels = Pixels(width, height);
+    auto render_milliseconds = 0.0;
+    for (int frame = 0; frame < num_frames; ++frame)
+    {
+        environment.extrinsics.yaw = 2.0 * pi * frame / num_frames;
+        const auto start = steady_clock::now();
+        if (shared_frames)
+            shared_frames->beginFrame(pixels, width, height);
+        vertexShader(vertices, environment);
+        auto options = DrawOptions{};
+        if (checkerboard_rendering)
+            options.checkerboard_parity = checkerboard.parity();
+        if (shading_rate_max_error > 0.0)
+            options.shading_rates = &shading_rates;
+        drawTriangles(pixels, vertices, triangles, shapes, textures,
+            potentially_visible_sets, lightmaps, shadow_map, environment, options);
+        if (checkerboard_rendering)
+            checkerboard.reconstruct(pixels, environment);
+        if (shading_rate_max_error > 0.0)
+            selectShadingRates(shading_rates, pixels, shading_rate_max_error);
+        if (shared_frames)
+            shared_frames->publishFrame();
+        render_milliseconds += duration<double, milli>(steady_clock::now() - start).count();
+
+        if (shared_frames)
+            continue;
+        if (output_prefix.empty())
+        {
+            frames.push_back(pixels);
+            continue;
+        }
+        char number[16];
+        snprintf(number, sizeof(number), "%04d", frame);
+        const auto output_filepath = output_prefix + number + ".ppm";
+        if (!savePpm(output_filepath, pixels))
+        {
+            cerr << "Could not write " << output_filepath << endl;
+            return 1;
+        }
+    }
+
+    cout << "Rendered " << num_frames << " frames of " << width << "x" << height
+         << " in " << render_milliseconds / num_frames << " ms per frame" << endl;
+    if (!frames.empty())
+        cout << "Kept " << frames.size() * width * height * sizeof(Pixel) / 1024 << " KB of frames in memory" << endl;
+    return 0;
+}
@@ -0,0 +1,219 @@
+// Times the raster, sampling, vertex and clear kernels on synthetic inputs,
+// so an optimization of one kernel can be measured without a model.
+// Reports the minimum and median of the repetitions.
+// Usage: microbenchmarks [repetitions]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "algorithm.hpp"
+#include "camera.hpp"
+#include "drawing.hpp"
+#include "drawing_template.hpp"
+#include "texture.hpp"
+
+namespace
+{
+
+const double PI = 3.14159265358979323846;
+const size_t IMAGE_SIZE = 1024;
+
+struct Timing
+{
+    double min_milliseconds;
+    double median_milliseconds;
+};
+
+template<typename Function>
+Timing measure(int repetitions, Function function)
+{
+    using namespace std::chrono;
+    auto milliseconds = std::vector<double>{};
+    for (int i = 0; i < repetitions; ++i)
+    {
+        const auto start = steady_clock::now();
+        function();
+        const auto stop = steady_clock::now();
+        milliseconds.push_back(duration<double, std::milli>(stop - start).count());
+    }
+    std::sort(milliseconds.begin(), milliseconds.end());
+    return Timing{ milliseconds.front(), milliseconds[milliseconds.size() / 2] };
+}
+
+void report(const std::string& name, const Timing& timing, double num_items, const std::string& item)
+{
+    std::cout << std::left << std::setw(40) << name << std::right
+              << std::setw(10) << std::fixed << std::setprecision(3) << timing.min_milliseconds << " ms min"
+              << std::setw(10) << timing.median_milliseconds << " ms median"
+              << std::setw(10) << std::setprecision(2) << 1e6 * timing.min_milliseconds / num_items
+              << " ns/" << item << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+}
+
+// Depth tests and writes a constant color, like the shaders of the
+// visibility passes, and counts the covered pixels.
+struct CountingShader
+{
+    Pixels* pixels;
+    size_t* num_covered;
+    void operator()(const Vector4d& vertex, size_t index) const
+    {
+        if (vertex(0) < 0.0 || vertex(1) < 0.0 || vertex(2) < 0.0) return;
+        ++*num_covered;
+        const auto disparity = vertex(3);
+        if (disparity <= pixels->disparities[index]) return;
+        pixels->disparities[index] = disparity;
+        pixels->colors[index] = 0xFFFFFFFF;
+    }
+};
+
+// Triangles with the given side lengths in pixels, at random positions
+// and orientations in the image.
+Vectors4d makeTriangles(size_t num_triangles, double length, double width, unsigned seed)
+{
+    auto generator = std::default_random_engine(seed);
+    auto position = std::uniform_real_distribution<double>(0.0, double(IMAGE_SIZE));
+    auto angle = std::uniform_real_distribution<double>(0.0, 2.0 * PI);
+    auto disparity = std::uniform_real_distribution<double>(0.1, 1.0);
+    auto corners = Vectors4d{};
+    for (size_t i = 0; i < num_triangles; ++i)
+    {
+        const auto x = position(generator);
+        const auto y = position(generator);
+        const auto a = angle(generator);
+        const auto d = disparity(generator);
+        const auto ux = std::cos(a);
+        const auto uy = std::sin(a);
+        // The base is `length` long and the apex `width` from its middle.
+        corners.push_back(Vector4d{ x - 0.5 * length * ux, y - 0.5 * length * uy, d, 1.0 });
+        corners.push_back(Vector4d{ x + 0.5 * length * ux, y + 0.5 * length * uy, d, 1.0 });
+        corners.push_back(Vector4d{ x - width * uy, y + width * ux, d, 1.0 });
+    }
+    return corners;
+}
+
+void benchmarkRasterizer(int repetitions)
+{
+    struct Distribution { std::string name; double length; double width; size_t num_triangles; };
+    // Equilateral triangles of about 1, 10 and 1000 pixels, and slivers.
+    const auto distributions = std::vector<Distribution>{
+        { "1 px", 1.52, 1.32, 200000 },
+        { "10 px", 4.81, 4.16, 100000 },
+        { "1000 px", 48.1, 41.6, 10000 },
+        { "sliver 400 x 0.5 px", 400.0, 0.5, 1000 },
+    };
+    auto pixels = Pixels(IMAGE_SIZE, IMAGE_SIZE);
+    for (const auto& distribution : distributions)
+    {
+        const auto corners = makeTriangles(distribution.num_triangles, distribution.length, distribution.width, 1);
+        auto num_covered = size_t{0};
+        const auto shader = CountingShader{ &pixels, &num_covered };
+        const auto timing = measure(repetitions, [&]()
+        {
+            fill(pixels.disparities, 0.0);
+            num_covered = 0;
+            for (size_t i = 0; i < corners.size(); i += 3)
+            {
+                const auto& v0 = corners[i + 0];
+                const auto& v1 = corners[i + 1];
+                const auto& v2 = corners[i + 2];
+                renderTriangleTemplate(v0, v1, v2,
+                    Vector4d{ 1.0, 0.0, 0.0, v0(2) },
+                    Vector4d{ 0.0, 1.0, 0.0, v1(2) },
+                    Vector4d{ 0.0, 0.0, 1.0, v2(2) },
+                    pixels.width, pixels.height, shader);
+            }
+        });
+        report("renderTriangleTemplate " + distribution.name, timing, double(distribution.num_triangles), "triangle");
+        report("  per covered pixel", timing, double(std::max<size_t>(num_covered, 1)), "pixel");
+    }
+}
+
+void benchmarkTextureSample(int repetitions)
+{
+    const auto num_samples = size_t{1} << 22;
+    auto generator = std::default_random_engine(2);
+    auto coordinate = std::uniform_real_distribution<double>(0.0, 1.0);
+    auto random_coordinates = Vectors2d(num_samples);
+    for (auto& c : random_coordinates)
+        c = Vector2d{ coordinate(generator), coordinate(generator) };
+    // Rows of samples along x, like the pixels of a triangle.
+    auto coherent_coordinates = Vectors2d(num_samples);
+    const auto row_length = size_t{1024};
+    for (size_t i = 0; i < num_samples; ++i)
+        coherent_coordinates[i] = Vector2d{ double(i % row_length) / row_length, double(i / row_length) / (num_samples / row_length) };
+
+    for (const auto size : { size_t{64}, size_t{512}, size_t{2048} })
+    {
+        auto texture = Texture(size, size);
+        for (size_t i = 0; i < texture.size(); ++i)
+            texture[i] = Vector4d{ double(i % 256), double(i / 7 % 256), double(i / 13 % 256), 0.0 };
+        for (const auto random : { false, true })
+        {
+            const auto& coordinates = random ? random_coordinates : coherent_coordinates;
+            auto sum = 0.0;
+            const auto timing = measure(repetitions, [&]()
+            {
+                for (const auto& c : coordinates)
+                    sum += texture.sample(c(0), c(1))(RED);
+            });
+            const auto name = "Texture::sample " + std::to_string(size) + "^2 " + (random ? "random" : "coherent");
+            report(name, timing, double(num_samples), "sample");
+            if (sum < 0.0) std::cout << sum;
+        }
+    }
+}
+
+void benchmarkVertexShader(int repetitions)
+{
+    const auto num_vertices = size_t{1} << 20;
+    auto generator = std::default_random_engine(3);
+    auto coordinate = std::uniform_real_distribution<double>(-10.0, 10.0);
+    auto vertices = Vertices(num_vertices);
+    for (size_t i = 0; i < num_vertices; ++i)
+    {
+        vertices.positions_world[i] = Vector4d{ coordinate(generator), coordinate(generator), coordinate(generator), 1.0 };
+        vertices.positions_texture[i] = Vector2d{ 0.5, 0.5 };
+    }
+    auto environment = Environment{ makeCameraIntrinsics(IMAGE_SIZE, IMAGE_SIZE), CameraExtrinsics{}, makeLight() };
+    environment.extrinsics.z = -20.0;
+
+    const auto timing = measure(repetitions, [&]() { vertexShader(vertices, environment); });
+    report("vertexShader", timing, double(num_vertices), "vertex");
+    quantizeVertices(vertices);
+    const auto quantized_timing = measure(repetitions, [&]() { vertexShader(vertices, environment); });
+    report("vertexShader quantized", quantized_timing, double(num_vertices), "vertex");
+}
+
+void benchmarkFill(int repetitions)
+{
+    for (const auto& size : { std::make_pair(640, 360), std::make_pair(1920, 1080) })
+    {
+        auto pixels = Pixels(size.first, size.second);
+        const auto resolution = std::to_string(size.first) + "x" + std::to_string(size.second);
+        const auto colors_timing = measure(repetitions, [&]() { fill(pixels.colors, Pixel{0}); });
+        report("fill colors " + resolution, colors_timing, double(pixels.size()), "pixel");
+        const auto disparities_timing = measure(repetitions, [&]() { fill(pixels.disparities, 0.0); });
+        report("fill disparities " + resolution, disparities_timing, double(pixels.size()), "pixel");
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const auto repetitions = argc > 1 ? std::max(1, atoi(argv[1])) : 11;
+    benchmarkRasterizer(repetitions);
+    benchmarkTextureSample(repetitions);
+    benchmarkVertexShader(repetitions);
+    benchmarkFill(repetitions);
+    return 0;
+}
@@ -0,0 +1,157 @@
+// Compares drawViews with independent vertexShader and drawTriangles calls
+// for a stereo pair, the six faces of a cube map and a rig of four cameras
+// at the start of a camera path, and checks that the images are the same.
+// Usage: multiview_benchmark model.obj camera_path.txt [resolution] [repetitions]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "camera.hpp"
+#include "camera_path.hpp"
+#include "drawing.hpp"
+#include "lightmap.hpp"
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include "pvs.hpp"
+#include "shadow_map.hpp"
+
+template<typename Function>
+double bestMilliseconds(int repetitions, Function function)
+{
+    using namespace std::chrono;
+    auto best = 1e300;
+    for (int i = 0; i < repetitions; ++i)
+    {
+        const auto start = steady_clock::now();
+        function();
+        const auto stop = steady_clock::now();
+        best = std::min(best, duration_cast<duration<double, std::milli>>(stop - start).count());
+    }
+    return best;
+}
+
+struct Rig
+{
+    std::string name;
+    Views views;
+};
+
+// Moves the camera along its own x axis.
+CameraExtrinsics offsetSideways(CameraExtrinsics extrinsics, double offset)
+{
+    const auto direction = Vector4d{ worldFromCamera(extrinsics) * Vector4d{ offset, 0.0, 0.0, 0.0 } };
+    extrinsics.x += direction(0);
+    extrinsics.y += direction(1);
+    extrinsics.z += direction(2);
+    return extrinsics;
+}
+
+std::vector<Rig> makeRigs(const CameraExtrinsics& pose, size_t resolution)
+{
+    const auto pi = 3.14159265358979323846;
+    const auto eye_distance = 0.065;
+    const auto intrinsics = makeCameraIntrinsics(resolution, resolution);
+    auto rigs = std::vector<Rig>(3);
+
+    rigs[0].name = "stereo pair";
+    rigs[0].views.emplace_back(intrinsics, offsetSideways(pose, -0.5 * eye_distance));
+    rigs[0].views.emplace_back(intrinsics, offsetSideways(pose, +0.5 * eye_distance));
+
+    rigs[1].name = "cube map";
+    const auto position = Vector4d{ pose.x, pose.y, pose.z, 1.0 };
+    for (int face = 0; face < NUM_CUBE_FACES; ++face)
+        rigs[1].views.emplace_back(intrinsics, makeCubeFaceExtrinsics(position, face));
+
+    rigs[2].name = "rig of 4";
+    for (int camera = 0; camera < 4; ++camera)
+    {
+        auto extrinsics = pose;
+        extrinsics.yaw += 0.5 * pi * camera;
+        rigs[2].views.emplace_back(intrinsics, extrinsics);
+    }
+    return rigs;
+}
+
+bool isSameImage(const Pixels& a, const Pixels& b)
+{
+    return std::equal(a.colors.begin(), a.colors.end(), b.colors.begin()) &&
+        std::equal(a.disparities.begin(), a.disparities.end(), b.disparities.begin());
+}
+
+int main(int argc, char** argv)
+{
+    using namespace std;
+    if (argc < 3)
+    {
+        cerr << "Usage: multiview_benchmark model.obj camera_path.txt [resolution] [repetitions]" << endl;
+        return 1;
+    }
+    const auto filepath = string(argv[1]);
+    const auto camera_path_filepath = string(argv[2]);
+    const auto resolution = argc > 3 ? size_t(atoi(argv[3])) : 512;
+    const auto repetitions = argc > 4 ? atoi(argv[4]) : 5;
+    const auto shadow_map_resolution = 512;
+    auto camera_path = vector<CameraExtrinsics>{};
+    if (!loadCameraPath(camera_path_filepath, camera_path) || camera_path.empty())
+    {
+        cerr << "Could not read camera path " << camera_path_filepath << endl;
+        return 1;
+    }
+
+    auto positions_world = Vectors4d{};
+    auto positions_texture = Vectors2d{};
+    auto triangles = Triangles{};
+    auto shapes = Shapes{};
+    auto textures = Textures{};
+    loadModel(filepath, positions_world, positions_texture, triangles, shapes, textures);
+    auto potentially_visible_sets = PotentiallyVisibleSets{};
+    const auto pvs_filepath = stripFileExtension(filepath) + ".pvs";
+    loadPotentiallyVisibleSets(pvs_filepath, hashMesh(positions_world, triangles, shapes), potentially_visible_sets);
+
+    auto vertices = Vertices(positions_world.size());
+    vertices.positions_world = positions_world;
+    vertices.positions_texture = positions_texture;
+    const auto light = makeLight();
+    const auto shadow_map = renderShadowMap(vertices, triangles, shapes, light.position_world, shadow_map_resolution);
+    const auto lightmaps = bakeLightmaps(vertices, triangles, light.position_world, shadow_map);
+
+    cout << endl;
+    cout << "resolution : " << resolution << " x " << resolution << ", " << numThreads() << " threads" << endl;
+    auto all_same = true;
+    for (auto& rig : makeRigs(camera_path.front(), resolution))
+    {
+        auto& views = rig.views;
+        auto pixels = vector<Pixels>(views.size(), Pixels(resolution, resolution));
+        auto environment = Environment{ views.front().intrinsics, CameraExtrinsics{}, light };
+        const auto independent_milliseconds = bestMilliseconds(repetitions, [&]()
+        {
+            for (size_t v = 0; v < views.size(); ++v)
+            {
+                environment.extrinsics = views[v].extrinsics;
+                vertexShader(vertices, environment);
+                drawTriangles(pixels[v], vertices, triangles, shapes, textures,
+                    potentially_visible_sets, lightmaps, shadow_map, environment);
+            }
+        });
+        const auto multiview_milliseconds = bestMilliseconds(repetitions, [&]()
+        {
+            drawViews(views, vertices, triangles, shapes, textures,
+                potentially_visible_sets, lightmaps, shadow_map, light);
+        });
+        auto same = true;
+        for (size_t v = 0; v < views.size(); ++v)
+            same = same && isSameImage(pixels[v], views[v].pixels);
+        all_same = all_same && same;
+
+        cout << rig.name << ", " << views.size() << " views" << (same ? "" : ", IMAGES DIFFER") << endl;
+        cout << "  independent : " << independent_milliseconds << " ms" << endl;
+        cout << "  drawViews   : " << multiview_milliseconds << " ms" << endl;
+        cout << "  speedup     : " << independent_milliseconds / multiview_milliseconds << endl;
+    }
+    return all_same ? 0 : 1;
+}
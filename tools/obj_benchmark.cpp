@@ -0,0 +1,80 @@
+// Compares the import time of tinyobj and the parallel OBJ parser.
+// Usage: obj_benchmark model.obj [repetitions]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "mesh.hpp"
+#include "obj_parser.hpp"
+#include "parallel.hpp"
+
+struct Model
+{
+    Vectors4d positions_world;
+    Vectors2d positions_texture;
+    Triangles triangles;
+    Shapes shapes;
+    Textures textures;
+};
+
+template<typename Function>
+double bestMilliseconds(int repetitions, Function function)
+{
+    using namespace std::chrono;
+    auto best = 1e300;
+    for (int i = 0; i < repetitions; ++i)
+    {
+        const auto start = steady_clock::now();
+        function();
+        const auto stop = steady_clock::now();
+        best = std::min(best, duration_cast<duration<double, std::milli>>(stop - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    using namespace std;
+    if (argc < 2)
+    {
+        cerr << "Usage: obj_benchmark model.obj [repetitions]" << endl;
+        return 1;
+    }
+    const auto filepath = string(argv[1]);
+    const auto repetitions = argc > 2 ? atoi(argv[2]) : 3;
+
+    auto tinyobj_model = Model{};
+    const auto tinyobj_milliseconds = bestMilliseconds(repetitions, [&]()
+    {
+        tinyobj_model = Model{};
+        auto& m = tinyobj_model;
+        loadObj(filepath, m.positions_world, m.positions_texture, m.triangles, m.shapes, m.textures);
+    });
+
+    auto parallel_model = Model{};
+    const auto parallel_milliseconds = bestMilliseconds(repetitions, [&]()
+    {
+        parallel_model = Model{};
+        auto& m = parallel_model;
+        loadObjParallel(filepath, m.positions_world, m.positions_texture, m.triangles, m.shapes, m.textures);
+    });
+
+    const auto same_triangles =
+        tinyobj_model.triangles.size() == parallel_model.triangles.size() &&
+        tinyobj_model.shapes.triangle_begins == parallel_model.shapes.triangle_begins &&
+        tinyobj_model.triangles.texture_indices == parallel_model.triangles.texture_indices;
+
+    cout << endl;
+    cout << "threads           : " << numThreads() << endl;
+    cout << "triangles         : " << parallel_model.triangles.size() << endl;
+    cout << "vertices tinyobj  : " << tinyobj_model.positions_world.size() << endl;
+    cout << "vertices parallel : " << parallel_model.positions_world.size() << endl;
+    cout << "same triangles    : " << (same_triangles ? "yes" : "no") << endl;
+    cout << "tinyobj           : " << tinyobj_milliseconds << " ms" << endl;
+    cout << "parallel          : " << parallel_milliseconds << " ms" << endl;
+    cout << "speedup           : " << tinyobj_milliseconds / parallel_milliseconds << endl;
+    return same_triangles ? 0 : 1;
+}
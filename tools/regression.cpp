@@ -0,0 +1,449 @@
+// Renders fixed camera poses of procedural scenes, and of models along
+// camera path files, and compares the colors and disparities with the
+// reference images in a directory. Besides the plain images it covers
+// quantized vertices, checkerboard reconstruction, shading rates and
+// drawViews. Writes a diff image of each mismatch,
+// with the differing pixels in red over the dimmed reference.
+// Usage: regression reference_dir [--update] [--color-tolerance levels]
+//            [--disparity-tolerance fraction] [--max-bad-pixels fraction]
+//            [--model model.obj camera_path.txt]...
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "camera.hpp"
+#include "camera_path.hpp"
+#include "checkerboard.hpp"
+#include "drawing.hpp"
+#include "lightmap.hpp"
+#include "mesh.hpp"
+#include "ppm.hpp"
+#include "pvs.hpp"
+#include "shading_rate.hpp"
+#include "shadow_map.hpp"
+
+namespace
+{
+
+const double PI = 3.14159265358979323846;
+const int WIDTH = 320;
+const int HEIGHT = 240;
+const size_t SHADOW_MAP_RESOLUTION = 256;
+// Shading rate error in 8-bit levels, and camera turn in radians between
+// the two checkerboard frames.
+const double SHADING_RATE_MAX_ERROR = 4.0;
+const double CHECKERBOARD_TURN = 0.02;
+const size_t CHECKER_TEXTURE = 0;
+const size_t WHITE_TEXTURE = 1;
+
+struct Scene
+{
+    std::string name;
+    Vectors4d positions_world;
+    Vectors2d positions_texture;
+    Triangles triangles;
+    Shapes shapes;
+    Textures textures;
+    PotentiallyVisibleSets potentially_visible_sets;
+    std::vector<CameraExtrinsics> poses;
+};
+
+struct Tolerances
+{
+    int color_levels = 2;
+    double disparity_fraction = 1e-4;
+    double max_bad_fraction = 0.001;
+};
+
+Texture makeCheckerTexture()
+{
+    const auto size = size_t{64};
+    auto texture = Texture(size, size);
+    for (size_t y = 0; y < size; ++y)
+    {
+        for (size_t x = 0; x < size; ++x)
+        {
+            const auto dark = (x / 8 + y / 8) % 2 == 0;
+            texture[y * size + x] = dark ? Vector4d{ 60, 90, 160, 0 } : Vector4d{ 230, 220, 190, 0 };
+        }
+    }
+    return texture;
+}
+
+void addTriangle(Scene& scene, size_t i0, size_t i1, size_t i2, size_t texture_index)
+{
+    scene.triangles.indices0.push_back(i0);
+    scene.triangles.indices1.push_back(i1);
+    scene.triangles.indices2.push_back(i2);
+    scene.triangles.texture_indices.push_back(texture_index);
+}
+
+void beginShape(Scene& scene)
+{
+    scene.shapes.triangle_begins.push_back(scene.triangles.size());
+    scene.shapes.triangle_ends.push_back(scene.triangles.size());
+}
+
+void endShape(Scene& scene)
+{
+    scene.shapes.triangle_ends.back() = scene.triangles.size();
+}
+
+// A grid of n x n quads in the plane y = height, with the texture repeated
+// once per quad.
+void addGround(Scene& scene, double height, double half_size, size_t n)
+{
+    beginShape(scene);
+    const auto first = scene.positions_world.size();
+    for (size_t j = 0; j <= n; ++j)
+    {
+        for (size_t i = 0; i <= n; ++i)
+        {
+            const auto x = -half_size + 2.0 * half_size * i / n;
+            const auto z = -half_size + 2.0 * half_size * j / n;
+            scene.positions_world.push_back(Vector4d{ x, height, z, 1.0 });
+            scene.positions_texture.push_back(Vector2d{ double(i), double(j) });
+        }
+    }
+    for (size_t j = 0; j < n; ++j)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const auto a = first + j * (n + 1) + i;
+            addTriangle(scene, a, a + 1, a + n + 2, CHECKER_TEXTURE);
+            addTriangle(scene, a, a + n + 2, a + n + 1, CHECKER_TEXTURE);
+        }
+    }
+    endShape(scene);
+}
+
+// Each face has its own four vertices, so it gets the whole texture.
+void addBox(Scene& scene, const Vector4d& box_min, const Vector4d& box_max, size_t texture_index)
+{
+    beginShape(scene);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (int side = 0; side < 2; ++side)
+        {
+            const auto u_axis = (axis + 1) % 3;
+            const auto v_axis = (axis + 2) % 3;
+            const auto first = scene.positions_world.size();
+            for (int corner = 0; corner < 4; ++corner)
+            {
+                const auto u = corner == 1 || corner == 2;
+                const auto v = corner >= 2;
+                auto p = Vector4d{ 0.0, 0.0, 0.0, 1.0 };
+                p(axis) = side ? box_max(axis) : box_min(axis);
+                p(u_axis) = u ? box_max(u_axis) : box_min(u_axis);
+                p(v_axis) = v ? box_max(v_axis) : box_min(v_axis);
+                scene.positions_world.push_back(p);
+                scene.positions_texture.push_back(Vector2d{ u ? 0.999 : 0.0, v ? 0.999 : 0.0 });
+            }
+            addTriangle(scene, first, first + 1, first + 2, texture_index);
+            addTriangle(scene, first, first + 2, first + 3, texture_index);
+        }
+    }
+    endShape(scene);
+}
+
+// A sphere of latitude and longitude bands, unlike makeSphere which only
+// makes points.
+void addSphere(Scene& scene, const Vector4d& center, double radius, size_t num_bands, size_t texture_index)
+{
+    beginShape(scene);
+    const auto first = scene.positions_world.size();
+    const auto num_segments = 2 * num_bands;
+    for (size_t j = 0; j <= num_bands; ++j)
+    {
+        const auto polar = PI * j / num_bands;
+        for (size_t i = 0; i <= num_segments; ++i)
+        {
+            const auto azimuth = 2.0 * PI * i / num_segments;
+            const auto direction = Vector4d{
+                std::sin(polar) * std::cos(azimuth), std::cos(polar), std::sin(polar) * std::sin(azimuth), 0.0 };
+            scene.positions_world.push_back(Vector4d{ center + radius * direction });
+            scene.positions_texture.push_back(Vector2d{ 4.0 * i / num_segments, 2.0 * j / num_bands });
+        }
+    }
+    for (size_t j = 0; j < num_bands; ++j)
+    {
+        for (size_t i = 0; i < num_segments; ++i)
+        {
+            const auto a = first + j * (num_segments + 1) + i;
+            const auto b = a + num_segments + 1;
+            if (j > 0)
+                addTriangle(scene, a, a + 1, b + 1, texture_index);
+            if (j + 1 < num_bands)
+                addTriangle(scene, a, b + 1, b, texture_index);
+        }
+    }
+    endShape(scene);
+}
+
+// The light of makeLight hangs 4 units above the ground of the scenes.
+std::vector<CameraExtrinsics> makeScenePoses()
+{
+    return {
+        CameraExtrinsics{ 0.0, -11.0, 9.0, 0.0, -0.3 },
+        CameraExtrinsics{ 7.0, -9.0, 5.0, -0.9, -0.5 },
+        CameraExtrinsics{ -3.0, -12.5, -6.0, 2.6, -0.1 },
+    };
+}
+
+Scene makeBoxesScene()
+{
+    auto scene = Scene{};
+    scene.name = "boxes";
+    scene.textures = Textures{ makeCheckerTexture(), Texture{} };
+    addGround(scene, -14.0, 8.0, 8);
+    addBox(scene, Vector4d{ -3.0, -14.0, -2.0, 1.0 }, Vector4d{ -1.0, -12.0, 0.0, 1.0 }, CHECKER_TEXTURE);
+    addBox(scene, Vector4d{ 1.0, -14.0, -1.0, 1.0 }, Vector4d{ 2.0, -11.0, 0.0, 1.0 }, WHITE_TEXTURE);
+    addBox(scene, Vector4d{ -1.0, -14.0, 2.0, 1.0 }, Vector4d{ 0.5, -13.5, 3.5, 1.0 }, CHECKER_TEXTURE);
+    scene.poses = makeScenePoses();
+    return scene;
+}
+
+Scene makeSphereScene()
+{
+    auto scene = Scene{};
+    scene.name = "sphere";
+    scene.textures = Textures{ makeCheckerTexture(), Texture{} };
+    addGround(scene, -14.0, 8.0, 8);
+    addSphere(scene, Vector4d{ 0.0, -12.5, 0.0, 1.0 }, 1.5, 24, CHECKER_TEXTURE);
+    addSphere(scene, Vector4d{ 3.0, -13.5, 2.0, 1.0 }, 0.5, 12, WHITE_TEXTURE);
+    scene.poses = makeScenePoses();
+    return scene;
+}
+
+bool loadScene(const std::string& filepath, const std::string& camera_path_filepath, Scene& scene)
+{
+    if (!loadCameraPath(camera_path_filepath, scene.poses) || scene.poses.empty())
+        return false;
+    loadModel(filepath, scene.positions_world, scene.positions_texture, scene.triangles, scene.shapes, scene.textures);
+    loadPotentiallyVisibleSets(stripFileExtension(filepath) + ".pvs",
+        hashMesh(scene.positions_world, scene.triangles, scene.shapes), scene.potentially_visible_sets);
+    auto name = stripFileExtension(filepath);
+    scene.name = name.substr(name.find_last_of("/\\") + 1);
+    return true;
+}
+
+// Counts the pixels that differ more than the tolerances and marks them
+// in the diff image.
+size_t comparePixels(const Pixels& reference, const Pixels& pixels, const Tolerances& tolerances, Pixels& diff)
+{
+    auto num_bad = size_t{0};
+    for (size_t i = 0; i < reference.size(); ++i)
+    {
+        auto bad = false;
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            const auto a = int((reference.colors[i] >> shift) & 0xFF);
+            const auto b = int((pixels.colors[i] >> shift) & 0xFF);
+            bad = bad || std::abs(a - b) > tolerances.color_levels;
+        }
+        const auto a = reference.disparities[i];
+        const auto b = pixels.disparities[i];
+        bad = bad || std::abs(a - b) > tolerances.disparity_fraction * std::max(std::abs(a), std::abs(b));
+        if (bad)
+        {
+            diff.colors[i] = 0xFFFF0000;
+            ++num_bad;
+        }
+        else
+        {
+            const auto color = reference.colors[i];
+            const auto gray = (((color >> 16) & 0xFF) + ((color >> 8) & 0xFF) + (color & 0xFF)) / 9;
+            diff.colors[i] = 0xFF000000 | (gray << 16) | (gray << 8) | gray;
+        }
+    }
+    return num_bad;
+}
+
+// Writes the pixels as the reference images of the name if updating, or
+// compares them with the reference images. Returns 1 if they do not match.
+int checkImage(const std::string& name, const Pixels& pixels, const std::string& reference_dir, bool update,
+    const Tolerances& tolerances)
+{
+    using namespace std;
+    const auto filepath = reference_dir + "/" + name;
+    if (update)
+    {
+        if (!savePpm(filepath + ".ppm", pixels) || !savePfm(filepath + ".pfm", pixels))
+        {
+            cerr << "Could not write " << filepath << endl;
+            return 1;
+        }
+        cout << "Updated " << name << endl;
+        return 0;
+    }
+    auto reference = Pixels(int(pixels.width), int(pixels.height));
+    if (!loadPpm(filepath + ".ppm", reference) || reference.width != pixels.width ||
+        reference.height != pixels.height || !loadPfm(filepath + ".pfm", reference))
+    {
+        cerr << "FAIL " << name << ": could not read the reference images" << endl;
+        return 1;
+    }
+    auto diff = Pixels(int(pixels.width), int(pixels.height));
+    const auto num_bad = comparePixels(reference, pixels, tolerances, diff);
+    if (double(num_bad) / pixels.size() <= tolerances.max_bad_fraction)
+    {
+        cout << "ok   " << name << ", " << num_bad << " pixels differ" << endl;
+        return 0;
+    }
+    cout << "FAIL " << name << ", " << num_bad << " pixels differ, see " << filepath << "_diff.ppm" << endl;
+    savePpm(filepath + "_diff.ppm", diff);
+    return 1;
+}
+
+// Renders each pose of the scene with per pixel lighting and with baked
+// lightmaps, and with lightmaps also from quantized vertices, as the second
+// of two checkerboard frames, and with shading rates selected from the full
+// rate frame. Returns the number of images that do not match. The images of
+// drawViews with one view per pose are compared with those of drawTriangles
+// instead of with references.
+int runScene(Scene& scene, const std::string& reference_dir, bool update, const Tolerances& tolerances)
+{
+    using namespace std;
+    auto vertices = Vertices(scene.positions_world.size());
+    vertices.positions_world = scene.positions_world;
+    vertices.positions_texture = scene.positions_texture;
+    auto quantized_vertices = vertices;
+    quantizeVertices(quantized_vertices);
+    if (scene.shapes.bounding_box_mins.size() != scene.shapes.size())
+        computeBoundingBoxes(scene.positions_world, scene.triangles, scene.shapes);
+
+    auto environment = Environment{ makeCameraIntrinsics(WIDTH, HEIGHT), CameraExtrinsics{}, makeLight() };
+    const auto shadow_map = renderShadowMap(vertices, scene.triangles, scene.shapes,
+        environment.light.position_world, SHADOW_MAP_RESOLUTION);
+    const auto lightmaps = bakeLightmaps(vertices, scene.triangles, environment.light.position_world, shadow_map);
+    const auto no_lightmaps = Lightmaps{};
+    const auto draw = [&](Pixels& pixels, const Vertices& vertices, const Lightmaps& lightmaps, const DrawOptions& options)
+    {
+        drawTriangles(pixels, vertices, scene.triangles, scene.shapes, scene.textures,
+            scene.potentially_visible_sets, lightmaps, shadow_map, environment, options);
+    };
+
+    auto num_failures = 0;
+    auto pixels = Pixels(WIDTH, HEIGHT);
+    auto lightmapped_images = vector<Pixels>{};
+    for (size_t pose = 0; pose < scene.poses.size(); ++pose)
+    {
+        const auto prefix = scene.name + "_" + to_string(pose);
+        environment.extrinsics = scene.poses[pose];
+        vertexShader(vertices, environment);
+        draw(pixels, vertices, no_lightmaps, DrawOptions{});
+        num_failures += checkImage(prefix + "_shadow_map", pixels, reference_dir, update, tolerances);
+        draw(pixels, vertices, lightmaps, DrawOptions{});
+        num_failures += checkImage(prefix + "_lightmap", pixels, reference_dir, update, tolerances);
+        lightmapped_images.push_back(pixels);
+
+        auto shading_rates = ShadingRates{};
+        shading_rates.materials = makeMaterialShadingRates(scene.textures);
+        selectShadingRates(shading_rates, pixels, SHADING_RATE_MAX_ERROR);
+        auto options = DrawOptions{};
+        options.shading_rates = &shading_rates;
+        draw(pixels, vertices, lightmaps, options);
+        num_failures += checkImage(prefix + "_shading_rates", pixels, reference_dir, update, tolerances);
+
+        vertexShader(quantized_vertices, environment);
+        draw(pixels, quantized_vertices, lightmaps, DrawOptions{});
+        num_failures += checkImage(prefix + "_quantized", pixels, reference_dir, update, tolerances);
+
+        // The first frame is turned a little, so the second one reprojects
+        // the pixels it does not draw.
+        auto checkerboard = CheckerboardReconstruction{};
+        for (const auto yaw : { CHECKERBOARD_TURN, 0.0 })
+        {
+            environment.extrinsics = scene.poses[pose];
+            environment.extrinsics.yaw += yaw;
+            vertexShader(vertices, environment);
+            options = DrawOptions{};
+            options.checkerboard_parity = checkerboard.parity();
+            draw(pixels, vertices, lightmaps, options);
+            checkerboard.reconstruct(pixels, environment);
+        }
+        num_failures += checkImage(prefix + "_checkerboard", pixels, reference_dir, update, tolerances);
+    }
+
+    auto views = Views{};
+    for (const auto& pose : scene.poses)
+        views.emplace_back(environment.intrinsics, pose);
+    drawViews(views, vertices, scene.triangles, scene.shapes, scene.textures,
+        scene.potentially_visible_sets, lightmaps, shadow_map, environment.light);
+    for (size_t pose = 0; pose < views.size(); ++pose)
+    {
+        const auto name = scene.name + "_" + to_string(pose) + "_views";
+        auto diff = Pixels(WIDTH, HEIGHT);
+        const auto num_bad = comparePixels(lightmapped_images[pose], views[pose].pixels, tolerances, diff);
+        if (double(num_bad) / diff.size() <= tolerances.max_bad_fraction)
+        {
+            cout << "ok   " << name << ", " << num_bad << " pixels differ from drawTriangles" << endl;
+            continue;
+        }
+        const auto filepath = reference_dir + "/" + name + "_diff.ppm";
+        cout << "FAIL " << name << ", " << num_bad << " pixels differ from drawTriangles, see " << filepath << endl;
+        savePpm(filepath, diff);
+        ++num_failures;
+    }
+    return num_failures;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    using namespace std;
+    const auto usage = "Usage: regression reference_dir [--update] [--color-tolerance levels] "
+        "[--disparity-tolerance fraction] [--max-bad-pixels fraction] [--model model.obj camera_path.txt]...";
+    if (argc < 2)
+    {
+        cerr << usage << endl;
+        return 1;
+    }
+    const auto reference_dir = string(argv[1]);
+    auto update = false;
+    auto tolerances = Tolerances{};
+    auto scenes = vector<Scene>{ makeBoxesScene(), makeSphereScene() };
+    for (int i = 2; i < argc; ++i)
+    {
+        const auto option = string(argv[i]);
+        if (option == "--update")
+            update = true;
+        else if (option == "--color-tolerance" && i + 1 < argc)
+            tolerances.color_levels = atoi(argv[++i]);
+        else if (option == "--disparity-tolerance" && i + 1 < argc)
+            tolerances.disparity_fraction = atof(argv[++i]);
+        else if (option == "--max-bad-pixels" && i + 1 < argc)
+            tolerances.max_bad_fraction = atof(argv[++i]);
+        else if (option == "--model" && i + 2 < argc)
+        {
+            scenes.emplace_back();
+            if (!loadScene(argv[i + 1], argv[i + 2], scenes.back()))
+            {
+                cerr << "Could not read camera path " << argv[i + 2] << endl;
+                return 1;
+            }
+            i += 2;
+        }
+        else
+        {
+            cerr << usage << endl;
+            return 1;
+        }
+    }
+
+    auto num_failures = 0;
+    for (auto& scene : scenes)
+        num_failures += runScene(scene, reference_dir, update, tolerances);
+    if (num_failures > 0)
+    {
+        cout << num_failures << " images failed" << endl;
+        return 1;
+    }
+    cout << (update ? "Updated all reference images" : "All images match") << endl;
+    return 0;
+}
@@ -0,0 +1,519 @@
+// Loads a model once and renders the poses that are requested over stdin,
+// or over a Unix domain socket if a socket path is given, so that many
+// renders do not each pay for loading the model and baking its lighting.
+// The requests that are waiting are rendered together with drawViews, one
+// view per request, which draws them in parallel.
+//
+// A request is one line of text:
+//     x y z yaw pitch [width height [fx fy cx cy]]
+// Without width and height the default resolution is used, and without
+// fx fy cx cy the intrinsics of makeCameraIntrinsics. Lines that are empty
+// or start with # are skipped. The response to each request, in order, is
+//     ok width height\n
+// followed by width * height ARGB colors as 32-bit integers and width *
+// height disparities as 32-bit floats, both in native byte order, or
+//     error message\n
+// Logging goes to stderr, so stdout only has responses. Over the socket,
+// each client gets its responses on its own thread, and a client that
+// stops reading is dropped instead of stalling the others. At most 64
+// clients are served at a time, and others get an error and are closed.
+//
+// Usage: render_server model.obj [width] [height] [socket_path]
+
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "camera.hpp"
+#include "drawing.hpp"
+#include "lightmap.hpp"
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include "pvs.hpp"
+#include "shadow_map.hpp"
+
+namespace
+{
+
+const size_t MAX_RESOLUTION = 16384;
+// A client that sends a longer line is dropped.
+const size_t MAX_LINE_LENGTH = 4096;
+// A client that has more responses than this waiting to be sent, or does
+// not read them for this long, is dropped.
+const size_t MAX_QUEUED_BYTES = size_t{1} << 28;
+const int SEND_TIMEOUT_SECONDS = 10;
+// Each client takes two threads and a file descriptor, so further clients
+// get an error and are closed.
+const size_t MAX_CLIENTS = 64;
+// How long to wait before accepting again after accept fails, for example
+// because there are no file descriptors left.
+const auto ACCEPT_RETRY_DELAY = std::chrono::milliseconds(100);
+
+// Writes all bytes or returns false.
+using WriteFunction = std::function<bool(const char* data, size_t size)>;
+
+struct Request
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    CameraIntrinsics intrinsics;
+    CameraExtrinsics extrinsics;
+    std::string error;
+    WriteFunction write;
+};
+
+using Requests = std::vector<Request, Eigen::aligned_allocator<Request>>;
+
+struct Scene
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Vertices vertices = Vertices(0);
+    Triangles triangles;
+    Shapes shapes;
+    Textures textures;
+    PotentiallyVisibleSets potentially_visible_sets;
+    Light light;
+    ShadowMap shadow_map;
+    Lightmaps lightmaps;
+};
+
+bool isSkipped(const std::string& line)
+{
+    const auto first = line.find_first_not_of(" \t\r");
+    return first == std::string::npos || line[first] == '#';
+}
+
+bool isResolution(double value)
+{
+    return value >= 1.0 && value <= MAX_RESOLUTION;
+}
+
+// Parses a whole argument as a resolution, or returns false.
+bool parseResolution(const char* text, size_t& resolution)
+{
+    auto end = static_cast<char*>(nullptr);
+    errno = 0;
+    const auto value = std::strtol(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || !isResolution(static_cast<double>(value)))
+        return false;
+    resolution = static_cast<size_t>(value);
+    return true;
+}
+
+Request parseRequest(const std::string& line, size_t default_width, size_t default_height)
+{
+    auto request = Request{};
+    auto stream = std::istringstream(line);
+    auto& extrinsics = request.extrinsics;
+    if (!(stream >> extrinsics.x >> extrinsics.y >> extrinsics.z >> extrinsics.yaw >> extrinsics.pitch))
+    {
+        request.error = "expected x y z yaw pitch";
+        return request;
+    }
+    auto width = default_width;
+    auto height = default_height;
+    auto values = std::vector<double>{};
+    auto value = 0.0;
+    while (stream >> value)
+        values.push_back(value);
+    if (!stream.eof() || (values.size() != 0 && values.size() != 2 && values.size() != 6))
+    {
+        request.error = "expected x y z yaw pitch [width height [fx fy cx cy]]";
+        return request;
+    }
+    // Some standard libraries parse nan and inf.
+    auto is_finite = std::isfinite(extrinsics.x) && std::isfinite(extrinsics.y) && std::isfinite(extrinsics.z) &&
+        std::isfinite(extrinsics.yaw) && std::isfinite(extrinsics.pitch);
+    for (const auto v : values)
+        is_finite = is_finite && std::isfinite(v);
+    if (!is_finite)
+    {
+        request.error = "the values must be finite";
+        return request;
+    }
+    if (values.size() >= 2)
+    {
+        if (!isResolution(values[0]) || !isResolution(values[1]))
+        {
+            request.error = "the resolution must be 1 to " + std::to_string(MAX_RESOLUTION);
+            return request;
+        }
+        width = static_cast<size_t>(values[0]);
+        height = static_cast<size_t>(values[1]);
+    }
+    request.intrinsics = makeCameraIntrinsics(width, height);
+    if (values.size() == 6)
+    {
+        if (values[2] <= 0.0 || values[3] <= 0.0)
+        {
+            request.error = "the focal lengths must be positive";
+            return request;
+        }
+        request.intrinsics.fx = values[2];
+        request.intrinsics.fy = values[3];
+        request.intrinsics.cx = values[4];
+        request.intrinsics.cy = values[5];
+    }
+    return request;
+}
+
+bool writeResponse(const WriteFunction& write, const Pixels& pixels)
+{
+    auto header = std::ostringstream{};
+    header << "ok " << pixels.width << " " << pixels.height << "\n";
+    auto disparities = std::vector<float>(pixels.disparities.begin(), pixels.disparities.end());
+    const auto& text = header.str();
+    return write(text.data(), text.size()) &&
+        write(reinterpret_cast<const char*>(pixels.colors.data()), pixels.size() * sizeof(Pixel)) &&
+        write(reinterpret_cast<const char*>(disparities.data()), disparities.size() * sizeof(float));
+}
+
+bool writeError(const WriteFunction& write, const std::string& error)
+{
+    const auto text = "error " + error + "\n";
+    return write(text.data(), text.size());
+}
+
+// Renders the valid requests as one call of drawViews and writes the
+// responses in the order of the requests.
+void renderBatch(const Scene& scene, const Requests& requests)
+{
+    auto views = Views{};
+    for (const auto& request : requests)
+    {
+        if (request.error.empty())
+            views.emplace_back(request.intrinsics, request.extrinsics);
+    }
+    drawViews(views, scene.vertices, scene.triangles, scene.shapes, scene.textures,
+        scene.potentially_visible_sets, scene.lightmaps, scene.shadow_map, scene.light);
+    auto view = views.begin();
+    for (const auto& request : requests)
+    {
+        if (request.error.empty())
+            writeResponse(request.write, (view++)->pixels);
+        else
+            writeError(request.write, request.error);
+    }
+}
+
+// Batches the requests that are already buffered on stdin.
+void serveStdin(const Scene& scene, size_t width, size_t height, size_t max_batch_size)
+{
+    using namespace std;
+    const auto write = [](const char* data, size_t size)
+    {
+        return static_cast<bool>(cout.write(data, size));
+    };
+    auto line = string{};
+    while (getline(cin, line))
+    {
+        auto requests = Requests{};
+        do
+        {
+            if (!isSkipped(line))
+            {
+                requests.push_back(parseRequest(line, width, height));
+                requests.back().write = write;
+            }
+        } while (requests.size() < max_batch_size && cin.rdbuf()->in_avail() > 0 && getline(cin, line));
+        renderBatch(scene, requests);
+        cout.flush();
+    }
+}
+
+#ifndef _WIN32
+
+// Requests from all connections, which the main thread renders in batches.
+class RequestQueue
+{
+public:
+    void push(Request request)
+    {
+        {
+            auto lock = std::lock_guard<std::mutex>(mutex_);
+            requests_.push_back(std::move(request));
+        }
+        condition_.notify_one();
+    }
+    // Waits for at least one request.
+    Requests pop(size_t max_size)
+    {
+        auto lock = std::unique_lock<std::mutex>(mutex_);
+        condition_.wait(lock, [&]() { return !requests_.empty(); });
+        auto requests = Requests{};
+        while (!requests_.empty() && requests.size() < max_size)
+        {
+            requests.push_back(std::move(requests_.front()));
+            requests_.pop_front();
+        }
+        return requests;
+    }
+private:
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<Request, Eigen::aligned_allocator<Request>> requests_;
+};
+
+// The responses to one client, which run sends on a thread of its own, so
+// that a client that does not read only stalls itself. Closes the socket
+// and counts the client as gone when both its reader and run are done.
+class Outbox
+{
+public:
+    Outbox(int socket, std::atomic<size_t>& num_clients)
+        : socket(socket), num_clients_(num_clients), num_queued_bytes_(0), finished_(false), dropped_(false) {}
+    ~Outbox()
+    {
+        close(socket);
+        --num_clients_;
+    }
+    // Queues the data, or returns false if the client was dropped. One
+    // response is always queued, however large it is.
+    bool push(const char* data, size_t size)
+    {
+        {
+            auto lock = std::lock_guard<std::mutex>(mutex_);
+            if (dropped_)
+                return false;
+            if (!chunks_.empty() && num_queued_bytes_ + size > MAX_QUEUED_BYTES)
+            {
+                drop();
+                return false;
+            }
+            chunks_.emplace_back(data, size);
+            num_queued_bytes_ += size;
+        }
+        condition_.notify_one();
+        return true;
+    }
+    // Called when no more data will be pushed.
+    void finish()
+    {
+        {
+            auto lock = std::lock_guard<std::mutex>(mutex_);
+            finished_ = true;
+        }
+        condition_.notify_one();
+    }
+    // Sends the queued data until finish is called and all of it is sent,
+    // or drops the client if sending fails or times out.
+    void run()
+    {
+        for (;;)
+        {
+            auto chunk = std::string{};
+            {
+                auto lock = std::unique_lock<std::mutex>(mutex_);
+                condition_.wait(lock, [this]() { return finished_ || dropped_ || !chunks_.empty(); });
+                if (dropped_ || chunks_.empty())
+                    return;
+                chunk = std::move(chunks_.front());
+                chunks_.pop_front();
+                num_queued_bytes_ -= chunk.size();
+            }
+            for (size_t sent = 0; sent < chunk.size();)
+            {
+                const auto written = send(socket, chunk.data() + sent, chunk.size() - sent, 0);
+                if (written <= 0)
+                {
+                    auto lock = std::lock_guard<std::mutex>(mutex_);
+                    drop();
+                    return;
+                }
+                sent += static_cast<size_t>(written);
+            }
+        }
+    }
+    const int socket;
+private:
+    // Also ends the read of the client.
+    void drop()
+    {
+        dropped_ = true;
+        chunks_.clear();
+        num_queued_bytes_ = 0;
+        shutdown(socket, SHUT_RDWR);
+    }
+    std::atomic<size_t>& num_clients_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<std::string> chunks_;
+    size_t num_queued_bytes_;
+    bool finished_;
+    bool dropped_;
+};
+
+// Finishes the outbox when the reader and all requests from it are done.
+struct Connection
+{
+    explicit Connection(std::shared_ptr<Outbox> outbox) : outbox(std::move(outbox)) {}
+    ~Connection() { outbox->finish(); }
+    std::shared_ptr<Outbox> outbox;
+};
+
+void readConnection(std::shared_ptr<Connection> connection, RequestQueue& queue, size_t width, size_t height)
+{
+    const auto write = [connection](const char* data, size_t size)
+    {
+        return connection->outbox->push(data, size);
+    };
+    auto buffered = std::string{};
+    char chunk[4096];
+    for (;;)
+    {
+        const auto num_read = read(connection->outbox->socket, chunk, sizeof(chunk));
+        if (num_read <= 0)
+            return;
+        buffered.append(chunk, static_cast<size_t>(num_read));
+        auto line_begin = size_t{0};
+        for (auto line_end = buffered.find('\n'); line_end != std::string::npos; line_end = buffered.find('\n', line_begin))
+        {
+            const auto line = buffered.substr(line_begin, line_end - line_begin);
+            line_begin = line_end + 1;
+            if (isSkipped(line))
+                continue;
+            auto request = parseRequest(line, width, height);
+            request.write = write;
+            queue.push(std::move(request));
+        }
+        buffered.erase(0, line_begin);
+        // The error is queued like a request, so it comes after the
+        // responses to the earlier lines.
+        if (buffered.size() > MAX_LINE_LENGTH)
+        {
+            auto request = Request{};
+            request.error = "lines must be at most " + std::to_string(MAX_LINE_LENGTH) + " characters";
+            request.write = write;
+            queue.push(std::move(request));
+            return;
+        }
+    }
+}
+
+bool serveSocket(const Scene& scene, const std::string& socket_path, size_t width, size_t height, size_t max_batch_size)
+{
+    using namespace std;
+    // Clients that disconnect early make send fail instead of ending the server.
+    signal(SIGPIPE, SIG_IGN);
+    const auto listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    auto address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    if (listener < 0 || socket_path.size() >= sizeof(address.sun_path))
+        return false;
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socket_path.c_str());
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0)
+        return false;
+    cerr << "Listening on " << socket_path << endl;
+
+    auto queue = RequestQueue{};
+    auto num_clients = atomic<size_t>{0};
+    auto acceptor = thread([&]()
+    {
+        for (;;)
+        {
+            const auto client = accept(listener, nullptr, nullptr);
+            if (client < 0)
+            {
+                if (errno != EINTR)
+                    this_thread::sleep_for(ACCEPT_RETRY_DELAY);
+                continue;
+            }
+            const auto timeout = timeval{ SEND_TIMEOUT_SECONDS, 0 };
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            if (num_clients >= MAX_CLIENTS)
+            {
+                const auto error = "error at most " + to_string(MAX_CLIENTS) + " clients at a time\n";
+                send(client, error.data(), error.size(), MSG_DONTWAIT);
+                close(client);
+                continue;
+            }
+            ++num_clients;
+            const auto outbox = make_shared<Outbox>(client, num_clients);
+            thread(&Outbox::run, outbox).detach();
+            thread(readConnection, make_shared<Connection>(outbox), ref(queue), width, height).detach();
+        }
+    });
+    for (;;)
+        renderBatch(scene, queue.pop(max_batch_size));
+}
+
+#endif
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    using namespace std;
+    auto width = size_t{640};
+    auto height = size_t{480};
+    if (argc < 2 || (argc > 2 && !parseResolution(argv[2], width)) || (argc > 3 && !parseResolution(argv[3], height)))
+    {
+        cerr << "Usage: render_server model.obj [width] [height] [socket_path]" << endl;
+        cerr << "The width and height must be 1 to " << MAX_RESOLUTION << endl;
+        return 1;
+    }
+    const auto filepath = string(argv[1]);
+    const auto socket_path = argc > 4 ? string(argv[4]) : string();
+    const auto shadow_map_resolution = 512;
+    // Two views per thread keep all threads busy when the views take
+    // different times.
+    const auto max_batch_size = 2 * numThreads();
+    ios::sync_with_stdio(false);
+
+    // The loaders log to stdout, which is reserved for responses.
+    auto stdout_buffer = cout.rdbuf(cerr.rdbuf());
+    auto scene = Scene{};
+    auto positions_world = Vectors4d{};
+    auto positions_texture = Vectors2d{};
+    loadModel(filepath, positions_world, positions_texture, scene.triangles, scene.shapes, scene.textures);
+    const auto pvs_filepath = stripFileExtension(filepath) + ".pvs";
+    loadPotentiallyVisibleSets(pvs_filepath, hashMesh(positions_world, scene.triangles, scene.shapes),
+        scene.potentially_visible_sets);
+    scene.vertices = Vertices(positions_world.size());
+    scene.vertices.positions_world = positions_world;
+    scene.vertices.positions_texture = positions_texture;
+    scene.light = makeLight();
+    scene.shadow_map = renderShadowMap(scene.vertices, scene.triangles, scene.shapes,
+        scene.light.position_world, shadow_map_resolution);
+    scene.lightmaps = bakeLightmaps(scene.vertices, scene.triangles, scene.light.position_world, scene.shadow_map);
+    cout.rdbuf(stdout_buffer);
+    cerr << "Loaded " << filepath << ", rendering up to " << max_batch_size << " requests at a time" << endl;
+
+    if (socket_path.empty())
+    {
+        serveStdin(scene, width, height, max_batch_size);
+        return 0;
+    }
+#ifdef _WIN32
+    cerr << "Sockets are not supported on Windows" << endl;
+    return 1;
+#else
+    if (!serveSocket(scene, socket_path, width, height, max_batch_size))
+    {
+        cerr << "Could not listen on " << socket_path << endl;
+        return 1;
+    }
+    return 0;
+#endif
+}
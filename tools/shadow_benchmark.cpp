@@ -0,0 +1,82 @@
+// Compares the depth-only shadow map pass with fully shaded rendering of
+// the same six cube faces around the light. Both draw the faces in
+// parallel, renderShadowMap with parallelFor and the shaded faces with
+// drawViews.
+// Usage: shadow_benchmark model.obj [resolution] [repetitions]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "camera.hpp"
+#include "drawing.hpp"
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include "shadow_map.hpp"
+
+template<typename Function>
+double bestMilliseconds(int repetitions, Function function)
+{
+    using namespace std::chrono;
+    auto best = 1e300;
+    for (int i = 0; i < repetitions; ++i)
+    {
+        const auto start = steady_clock::now();
+        function();
+        const auto stop = steady_clock::now();
+        best = std::min(best, duration_cast<duration<double, std::milli>>(stop - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    using namespace std;
+    if (argc < 2)
+    {
+        cerr << "Usage: shadow_benchmark model.obj [resolution] [repetitions]" << endl;
+        return 1;
+    }
+    const auto filepath = string(argv[1]);
+    const auto resolution = argc > 2 ? size_t(atoi(argv[2])) : 512;
+    const auto repetitions = argc > 3 ? atoi(argv[3]) : 5;
+
+    auto positions_world = Vectors4d{};
+    auto positions_texture = Vectors2d{};
+    auto triangles = Triangles{};
+    auto shapes = Shapes{};
+    auto textures = Textures{};
+    loadModel(filepath, positions_world, positions_texture, triangles, shapes, textures);
+
+    auto vertices = Vertices(positions_world.size());
+    vertices.positions_world = positions_world;
+    vertices.positions_texture = positions_texture;
+    const auto light = makeLight();
+
+    const auto shadow_milliseconds = bestMilliseconds(repetitions, [&]()
+    {
+        renderShadowMap(vertices, triangles, shapes, light.position_world, resolution);
+    });
+
+    auto views = Views{};
+    for (int face = 0; face < NUM_CUBE_FACES; ++face)
+    {
+        views.emplace_back(makeCameraIntrinsics(resolution, resolution),
+            makeCubeFaceExtrinsics(light.position_world, face));
+    }
+    const auto shaded_milliseconds = bestMilliseconds(repetitions, [&]()
+    {
+        drawViews(views, vertices, triangles, shapes, textures,
+            PotentiallyVisibleSets{}, Lightmaps{}, ShadowMap{}, light);
+    });
+
+    cout << endl;
+    cout << "resolution  : " << resolution << " x " << resolution << " x " << NUM_CUBE_FACES
+         << ", " << numThreads() << " threads" << endl;
+    cout << "depth only  : " << shadow_milliseconds << " ms" << endl;
+    cout << "shaded      : " << shaded_milliseconds << " ms" << endl;
+    cout << "speedup     : " << shaded_milliseconds / shadow_milliseconds << endl;
+    return 0;
+}
@@ -0,0 +1,99 @@
+// Reads the frames that headless or another SharedFrameWriter publishes in
+// shared memory, without copying them. Reads every frame that is still in
+// the ring, and reports the frames that were overwritten before they could
+// be read, because the writer got a full ring ahead, and the frames that
+// were overwritten while they were read. Waits for the writer to start,
+// and stops after the number of frames or when no frame is published for
+// a second.
+// Usage: shared_frames_reader /name [frames]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "shared_frames.hpp"
+
+namespace
+{
+
+const int TIMEOUT_MILLISECONDS = 1000;
+const int OPEN_ATTEMPTS = 500;
+
+// Counts the pixels that a triangle was drawn to.
+size_t countCoveredPixels(const SharedFrame& frame)
+{
+    auto count = size_t{0};
+    for (size_t i = 0; i < frame.width * frame.height; ++i)
+        count += frame.disparities[i] > 0.0;
+    return count;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    using namespace std;
+    if (argc < 2)
+    {
+        cerr << "Usage: shared_frames_reader /name [frames]" << endl;
+        return 1;
+    }
+    const auto name = string(argv[1]);
+    const auto max_frames = argc > 2 ? uint64_t(atoll(argv[2])) : UINT64_MAX;
+
+    auto reader = unique_ptr<SharedFrameReader>{};
+    for (int attempt = 0; attempt < OPEN_ATTEMPTS; ++attempt)
+    {
+        reader = make_unique<SharedFrameReader>(name);
+        if (reader->isOpen())
+            break;
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    if (!reader->isOpen())
+    {
+        cerr << "Could not open shared memory " << name << endl;
+        return 1;
+    }
+    cout << "Opened " << name << " with " << reader->numSlots() << " slots" << endl;
+
+    auto num_seen = uint64_t{0};
+    auto num_read = uint64_t{0};
+    auto num_overwritten = uint64_t{0};
+    auto num_torn = uint64_t{0};
+    while (num_read < max_frames)
+    {
+        const auto num_published = reader->waitForFrames(num_seen, TIMEOUT_MILLISECONDS);
+        if (num_published == num_seen)
+            break;
+        // Older frames are no longer in the ring.
+        const auto oldest = max<uint64_t>(num_seen, num_published - min<uint64_t>(num_published, reader->numSlots()));
+        num_overwritten += oldest - num_seen;
+        for (auto number = oldest; number < num_published && num_read < max_frames; ++number)
+        {
+            auto frame = SharedFrame{};
+            if (!reader->beginRead(number, frame))
+            {
+                ++num_overwritten;
+                continue;
+            }
+            const auto covered_pixels = countCoveredPixels(frame);
+            if (!reader->endRead(frame))
+            {
+                ++num_torn;
+                continue;
+            }
+            ++num_read;
+            cout << "Frame " << frame.number << ": " << frame.width << "x" << frame.height
+                 << ", " << covered_pixels << " covered pixels" << endl;
+        }
+        num_seen = num_published;
+    }
+    cout << "Read " << num_read << " frames, " << num_overwritten << " were overwritten before they were read"
+         << " and " << num_torn << " while they were read" << endl;
+    return 0;
+}